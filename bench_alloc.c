@@ -0,0 +1,254 @@
+/*
+                bench_alloc.c
+
+        This program compares UArray2_new with UArray2_new_large and
+        Bit2_new with Bit2_new_large on a large raster. For each it
+        reports the time to allocate and first fill it, to scan every
+        element in row major and in column major order, and the data
+        TLB misses of each scan (when the kernel lets us read the
+        counter). The first fill is timed with the allocation because
+        UArray2_new and Bit2_new leave the pages to be touched by it
+        while the _large versions touch them as they allocate.
+
+        Usage: ./bench_alloc [width height [threads]]
+
+        Authors: Kenneth Xue (kxue01)
+                Alyssa Rose (arose10)
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "uarray2.h"
+#include "uarray2t.h"
+#include "bit2.h"
+
+double now(void);
+int open_tlb_counter(void);
+void start_counter(int fd);
+long long stop_counter(int fd);
+void report(const char *what, double seconds, long long misses,
+            double bytes);
+void bench_uarray2(const char *name, UArray2_T arr, double alloc_time,
+                   int fd);
+void bench_bit2(const char *name, Bit2_T bits, double alloc_time, int fd);
+
+int main(int argc, char *argv[])
+{
+        int width = 8192;
+        int height = 8192;
+        int threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (argc >= 3) {
+                width = atoi(argv[1]);
+                height = atoi(argv[2]);
+        }
+        if (argc >= 4) {
+                threads = atoi(argv[3]);
+        }
+        if (width <= 0 || height <= 0 || threads <= 0 || argc == 2 ||
+            argc > 4) {
+                fprintf(stderr, "Usage: %s [width height [threads]]\n",
+                        argv[0]);
+                exit(1);
+        }
+        int fd = open_tlb_counter();
+        printf("%d x %d, %d threads\n", width, height, threads);
+        printf("%-28s %10s %12s %10s\n", "", "seconds", "dTLB misses",
+               "MB/s");
+
+        double start = now();
+        UArray2_T arr = UArray2_u8_new(width, height);
+        bench_uarray2("UArray2_new", arr, now() - start, fd);
+        UArray2_free(&arr);
+
+        start = now();
+        arr = UArray2_new_large(width, height, sizeof(uint8_t), threads);
+        bench_uarray2("UArray2_new_large", arr, now() - start, fd);
+        UArray2_free(&arr);
+
+        start = now();
+        Bit2_T bits = Bit2_new(width, height);
+        bench_bit2("Bit2_new", bits, now() - start, fd);
+        Bit2_free(&bits);
+
+        start = now();
+        bits = Bit2_new_large(width, height, threads);
+        bench_bit2("Bit2_new_large", bits, now() - start, fd);
+        Bit2_free(&bits);
+
+        if (fd < 0) {
+                printf("(dTLB counter not available on this system)\n");
+        } else {
+                close(fd);
+        }
+        exit(0);
+}
+
+/*
+Description: Times a UArray2_T of bytes: fills it row by row, reported
+        together with its allocation, then sums it in row major order
+        and in column major order
+Input: a name for the report, the array, the time its allocation took,
+        the TLB counter (or -1)
+Output: none
+*/
+void bench_uarray2(const char *name, UArray2_T arr, double alloc_time,
+                   int fd)
+{
+        double bytes = (double)UArray2_width(arr) * UArray2_height(arr);
+        char label[64];
+        start_counter(fd);
+        double start = now();
+        UARRAY2_TRANSFORM(uint8_t, arr, x, (uint8_t)(x + 1));
+        double seconds = now() - start;
+        snprintf(label, sizeof(label), "%s alloc+fill", name);
+        report(label, alloc_time + seconds, stop_counter(fd), bytes);
+
+        unsigned long sum = 0;
+        start_counter(fd);
+        start = now();
+        for (int row = 0; row < UArray2_height(arr); row++) {
+                uint8_t *elems = UArray2_u8_row(arr, row);
+                for (int col = 0; col < UArray2_width(arr); col++) {
+                        sum += elems[col];
+                }
+        }
+        seconds = now() - start;
+        snprintf(label, sizeof(label), "%s row scan", name);
+        report(label, seconds, stop_counter(fd), bytes);
+
+        start_counter(fd);
+        start = now();
+        for (int col = 0; col < UArray2_width(arr); col++) {
+                for (int row = 0; row < UArray2_height(arr); row++) {
+                        sum += *UArray2_u8_at(arr, col, row);
+                }
+        }
+        seconds = now() - start;
+        snprintf(label, sizeof(label), "%s col scan", name);
+        report(label, seconds, stop_counter(fd), bytes);
+
+        if (sum != 2 * (unsigned long)bytes) {
+                fprintf(stderr, "%s: wrong sum\n", name);
+        }
+}
+
+/*
+Description: Times a Bit2_T: sets every eighth bit, reported together
+        with its allocation, then counts it
+Input: a name for the report, the bit array, the time its allocation
+        took, the TLB counter (or -1)
+Output: none
+*/
+void bench_bit2(const char *name, Bit2_T bits, double alloc_time, int fd)
+{
+        double bytes = (double)Bit2_width(bits) * Bit2_height(bits) / 8;
+        char label[64];
+        start_counter(fd);
+        double start = now();
+        for (int y = 0; y < Bit2_height(bits); y++) {
+                for (int x = 0; x < Bit2_width(bits); x += 8) {
+                        Bit2_put(bits, x, y, 1);
+                }
+        }
+        double seconds = now() - start;
+        snprintf(label, sizeof(label), "%s alloc+put", name);
+        report(label, alloc_time + seconds, stop_counter(fd), bytes);
+
+        start_counter(fd);
+        start = now();
+        int count = Bit2_count(bits);
+        seconds = now() - start;
+        snprintf(label, sizeof(label), "%s count", name);
+        report(label, seconds, stop_counter(fd), bytes);
+
+        if (count != (Bit2_width(bits) + 7) / 8 * Bit2_height(bits)) {
+                fprintf(stderr, "%s: wrong count\n", name);
+        }
+}
+
+/*
+Description: Prints one line of the report
+Input: what was timed, the time it took, its TLB misses (-1 if
+        unknown) and the number of bytes it covered
+Output: none
+*/
+void report(const char *what, double seconds, long long misses,
+            double bytes)
+{
+        if (misses < 0) {
+                printf("%-28s %10.4f %12s %10.0f\n", what, seconds, "-",
+                       bytes / seconds / 1e6);
+        } else {
+                printf("%-28s %10.4f %12lld %10.0f\n", what, seconds,
+                       misses, bytes / seconds / 1e6);
+        }
+}
+
+/*
+Description: Returns the current time in seconds
+Input: none
+Output: the time (double)
+*/
+double now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+Description: Opens a counter of data TLB read misses for this thread
+Input: none
+Output: the counter's file descriptor, or -1 if it is not available
+*/
+int open_tlb_counter(void)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+Description: Resets and starts the TLB counter
+Input: the counter's file descriptor (or -1)
+Output: none
+*/
+void start_counter(int fd)
+{
+        if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+/*
+Description: Stops the TLB counter and reads it
+Input: the counter's file descriptor (or -1)
+Output: the number of misses, or -1 if there is no counter
+*/
+long long stop_counter(int fd)
+{
+        long long misses = -1;
+        if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &misses, sizeof(misses)) != sizeof(misses)) {
+                        misses = -1;
+                }
+        }
+        return misses;
+}
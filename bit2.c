@@ -6,10 +6,19 @@
         Authors: Kenneth Xue (kxue01)
                 Alyssa Rose (arose10)
 */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <except.h>
 #include <uarray.h>
+#include <seq.h>
 #include <bit2.h>
 #include <bit.h>
 #include <assert.h>
@@ -20,10 +29,75 @@ struct Bit2_T {
         UArray_T spine;
         int height;
         int width;
+        /* occupancy pyramid, NULL until Bit2_pyramid_build is called */
+        T any[BIT2_LEVELS];
+        T all[BIT2_LEVELS];
+        /* the array owning the rows (itself unless this is a view) and
+        where this array's top left corner lies in it */
+        T root;
+        int x0, y0;
+        /* number of 1 bits in each BIT2_BLOCK1 square block (row major,
+        count_cols blocks to a row) and in each row of blocks, NULL
+        until Bit2_track_counts is called */
+        UArray_T counts;
+        UArray_T band_counts;
+        int count_cols;
+        /* copy on write rows: bit y is 1 when row y's Bit_T is shared
+        with other rows and must be copied before it is changed; the
+        pool holds every shared Bit_T (the first being the blank row)
+        so they can be freed. Both NULL until a row is shared. */
+        Bit_T shared;
+        Seq_T pool;
 };
 
 static Except_T Bad_Alloc = { "Could not allocate memory" };
 static Except_T Bounds = {"Input out of bounds"};
+static Except_T View = {"Operation not supported on a view"};
+static Except_T Format = {"Not a readable Bit2 file"};
+
+/*
+Struct holding the fields of a native format header
+*/
+struct header {
+        int width, height;
+        long row_bytes;
+        int tile;
+        long index_offset, data_offset;
+};
+
+/*
+Struct telling one Bit2_new_large thread which rows to allocate
+*/
+struct band {
+        T bitarr;
+        int first, last;
+};
+
+static Bit_T row_of(T bitarr, int y);
+static Bit_T row_for_write(T bitarr, int y);
+static int row_shared(T bitarr, int y);
+static void start_sharing(T bitarr);
+static Bit_T share_target(T bitarr, int y, Bit_T row);
+static void point_row(T bitarr, int y, Bit_T target);
+static int full_width(T bitarr);
+static int span_count(T bitarr, int y);
+static void init_fields(T bitarr, int width, int height);
+static void clear_root_rect(T bitarr, int x, int y, int width, int height);
+static int *block_count(T bitarr, int x, int y);
+static void count_add(T bitarr, int x, int y, int delta);
+static void recount(T bitarr);
+static void *make_band(void *cl);
+static void pyramid_mark(T bitarr, int x, int y, int thisBit);
+static void pack_row(T bitarr, int y, unsigned char *bytes);
+static void unpack_bits(Bit_T row, int x0, const unsigned char *bytes,
+                        int lo, int hi);
+static void unpack_tiles(Bit_T row, int x0, const unsigned char *bytes,
+                         const unsigned char *tiles, int lo, int hi);
+static int tile_kind(const unsigned char *data, long row_bytes, int tx,
+                     int ty, int width, int height);
+static void put_le(unsigned char *bytes, uint64_t value, int size);
+static uint64_t get_le(const unsigned char *bytes, int size);
+static struct header parse_header(const unsigned char *bytes);
 
 /*
 Description: Creates a new Bit2 array of size height * width
@@ -36,8 +110,7 @@ T Bit2_new(int width, int height)
         if (thisBit2 == NULL) {
                 RAISE(Bad_Alloc);
         }
-        thisBit2->height = height;
-        thisBit2->width = width;
+        init_fields(thisBit2, width, height);
 
         UArray_T spine = UArray_new(height, sizeof(Bit_T));
         thisBit2->spine = spine;
@@ -54,6 +127,120 @@ T Bit2_new(int width, int height)
         return thisBit2;
 }
 
+/*
+Description: Creates a new Bit2 array of size height * width whose rows
+        all share its one blank row
+Input: the width (int) and height (int) of the new Bit2_T
+Output: a pointer to a Bit2_T array
+*/
+T Bit2_new_shared(int width, int height)
+{
+        T thisBit2 = malloc(sizeof(struct Bit2_T));
+        if (thisBit2 == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        init_fields(thisBit2, width, height);
+        thisBit2->spine = UArray_new(height, sizeof(Bit_T));
+        start_sharing(thisBit2);
+
+        Bit_T blank = Seq_get(thisBit2->pool, 0);
+        for (int i = 0; i < height; i++) {
+                *(Bit_T *)UArray_at(thisBit2->spine, i) = blank;
+        }
+        if (height > 0) {
+                Bit_set(thisBit2->shared, 0, height - 1);
+        }
+        return thisBit2;
+}
+
+/*
+Description: Creates a new Bit2 array of size height * width whose rows
+        are allocated by nthreads threads, one band of rows each
+Input: the width (int), height (int) and number of threads (int)
+Output: a pointer to a Bit2_T array
+*/
+T Bit2_new_large(int width, int height, int nthreads)
+{
+        assert(nthreads > 0);
+        T thisBit2 = malloc(sizeof(struct Bit2_T));
+        if (thisBit2 == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        init_fields(thisBit2, width, height);
+        thisBit2->spine = UArray_new(height, sizeof(Bit_T));
+
+        if (nthreads > height) {
+                nthreads = height > 0 ? height : 1;
+        }
+        pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+        struct band *bands = malloc(nthreads * sizeof(struct band));
+        if (threads == NULL || bands == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        for (int i = 0; i < nthreads; i++) {
+                bands[i].bitarr = thisBit2;
+                bands[i].first = (int)((long)height * i / nthreads);
+                bands[i].last = (int)((long)height * (i + 1) / nthreads);
+        }
+        /* the calling thread makes the first band itself, and any band
+        whose thread could not be started */
+        int started = 1;
+        for (; started < nthreads; started++) {
+                if (pthread_create(&threads[started], NULL, make_band,
+                                   &bands[started]) != 0) {
+                        break;
+                }
+        }
+        make_band(&bands[0]);
+        for (int i = started; i < nthreads; i++) {
+                make_band(&bands[i]);
+        }
+        for (int i = 1; i < started; i++) {
+                pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(bands);
+        return thisBit2;
+}
+
+/*
+Description: Makes a view of the rectangle of bitarr with top left
+        corner (x, y) and the given width and height. The view shares
+        bitarr's bits, so nothing is copied, and every Bit2 function
+        takes it with coordinates relative to its own corner.
+Input: pointer to Bit2_T bitarr, int x, int y, int width, int height
+Output: a pointer to the view
+*/
+T Bit2_view(T bitarr, int x, int y, int width, int height)
+{
+        assert(bitarr != NULL);
+        if (x < 0 || y < 0 || width < 0 || height < 0 ||
+            x + width > bitarr->width || y + height > bitarr->height) {
+                RAISE(Bounds);
+        }
+        T view = malloc(sizeof(struct Bit2_T));
+        if (view == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        init_fields(view, width, height);
+        view->spine = bitarr->spine;
+        view->root = bitarr->root;
+        view->x0 = bitarr->x0 + x;
+        view->y0 = bitarr->y0 + y;
+        return view;
+}
+
+/*
+Description: Returns whether bitarr is a view of another Bit2_T
+Input: pointer to Bit2_T bitarr
+Output: 1 if it is a view, 0 if it owns its bits
+*/
+int Bit2_is_view(T bitarr)
+{
+        assert(bitarr != NULL);
+        return bitarr->root != bitarr;
+}
+
 /*
 Description: Returns the height of the Bit2_T array pointed
         to by the bit bitarr
@@ -86,12 +273,25 @@ Output: none
 */
 int Bit2_put(T bitarr, int width, int height, int thisBit)
 {
-        if (width >= bitarr->width || height >= bitarr->height) {
+        if (width < 0 || height < 0 ||
+            width >= bitarr->width || height >= bitarr->height) {
                 RAISE(Bounds);
         }
-        Bit_T *row_arr = UArray_at((bitarr->spine), height);
-        int x = Bit_get(*row_arr, width);
-        Bit_put(*row_arr, width, thisBit);
+        /* a shared row is only copied when the bit really changes */
+        if (row_shared(bitarr, height) &&
+            Bit_get(row_of(bitarr, height), width + bitarr->x0) == thisBit) {
+                return thisBit;
+        }
+        int x = Bit_put(row_for_write(bitarr, height), width + bitarr->x0,
+                        thisBit);
+        if (bitarr->root->any[0] != NULL) {
+                pyramid_mark(bitarr->root, width + bitarr->x0,
+                             height + bitarr->y0, thisBit);
+        }
+        if (bitarr->root->counts != NULL && x != thisBit) {
+                count_add(bitarr->root, width + bitarr->x0,
+                          height + bitarr->y0, thisBit - x);
+        }
         return x;
 }
 /*
@@ -102,11 +302,11 @@ Output: int representing the value of the bit
 */
 int Bit2_get(T bitarr, int width, int height)
 {
-        if (width >= bitarr->width || height >= bitarr->height) {
+        if (width < 0 || height < 0 ||
+            width >= bitarr->width || height >= bitarr->height) {
                 RAISE(Bounds);
         }
-        Bit_T *row_arr = UArray_at((bitarr->spine), height);
-        return Bit_get(*row_arr, width);
+        return Bit_get(row_of(bitarr, height), width + bitarr->x0);
 }
 
 /*
@@ -116,11 +316,32 @@ Output: nothing
 */
 void Bit2_free(T *bitarr)
 {
+        if ((*bitarr)->root != *bitarr) {
+                free(*bitarr);
+                *bitarr = NULL;
+                return;
+        }
+        Bit2_pyramid_free(*bitarr);
+        if ((*bitarr)->counts != NULL) {
+                UArray_free(&(*bitarr)->counts);
+                UArray_free(&(*bitarr)->band_counts);
+        }
         for (int i = 0; i < Bit2_height(*bitarr); i++) {
+                if (row_shared(*bitarr, i)) {
+                        continue;
+                }
                 Bit_T *thisArr = UArray_at(((*bitarr)->spine), i);
                 Bit_free(thisArr);
                 thisArr = NULL;
         }
+        if ((*bitarr)->pool != NULL) {
+                while (Seq_length((*bitarr)->pool) > 0) {
+                        Bit_T row = Seq_remhi((*bitarr)->pool);
+                        Bit_free(&row);
+                }
+                Seq_free(&(*bitarr)->pool);
+                Bit_free(&(*bitarr)->shared);
+        }
         UArray_free(&((*bitarr)->spine));
         free(*bitarr);
         bitarr = NULL;
@@ -171,3 +392,1367 @@ void Bit2_map_col_major(T bitarr,
                 }
         }
 }
+
+/*
+Description: Returns the number of 1 bits in the Bit2_T array, from the
+        block counts or skipping blank blocks of the occupancy pyramid
+Input: pointer to Bit2_T bitarr
+Output: (int) the number of 1 bits
+*/
+int Bit2_count(T bitarr)
+{
+        assert(bitarr != NULL);
+        int count = 0;
+        if (bitarr->counts != NULL) {
+                for (int i = 0; i < UArray_length(bitarr->band_counts); i++) {
+                        count += *(int *)UArray_at(bitarr->band_counts, i);
+                }
+                return count;
+        }
+        for (int y = 0; y < bitarr->height; y++) {
+                /* a blank band of level 0 blocks has no 1 bits to count */
+                if (bitarr->any[0] != NULL && y % BIT2_BLOCK0 == 0 &&
+                    Bit_count(row_of(bitarr->any[0], y / BIT2_BLOCK0)) == 0) {
+                        y += BIT2_BLOCK0 - 1;
+                        continue;
+                }
+                count += span_count(bitarr, y);
+        }
+        return count;
+}
+
+/*
+Description: Finds the smallest rectangle holding every 1 bit of bitarr
+Input: pointer to Bit2_T bitarr, pointers to ints that get the x, y,
+        width and height of the rectangle
+Output: 1 if bitarr has a 1 bit, 0 if it is blank
+*/
+int Bit2_bbox(T bitarr, int *x, int *y, int *width, int *height)
+{
+        assert(bitarr != NULL);
+        int top = -1;
+        int bottom = -1;
+        Bit_T columns = NULL;
+        for (int j = 0; j < bitarr->height; j++) {
+                Bit_T row = row_of(bitarr, j);
+                if (span_count(bitarr, j) == 0) {
+                        continue;
+                }
+                if (top < 0) {
+                        top = j;
+                }
+                bottom = j;
+                Bit_T merged = Bit_union(columns, row);
+                if (columns != NULL) {
+                        Bit_free(&columns);
+                }
+                columns = merged;
+        }
+        if (top < 0) {
+                return 0;
+        }
+
+        /* the union holds whole rows; only the view's columns count */
+        int left = bitarr->x0;
+        while (!Bit_get(columns, left)) {
+                left++;
+        }
+        int right = bitarr->x0 + bitarr->width - 1;
+        while (!Bit_get(columns, right)) {
+                right--;
+        }
+        left -= bitarr->x0;
+        right -= bitarr->x0;
+        Bit_free(&columns);
+
+        *x = left;
+        *y = top;
+        *width = right - left + 1;
+        *height = bottom - top + 1;
+        return 1;
+}
+
+/*
+Description: Sets every bit of the rectangle with top left corner
+        (x, y) and the given width and height to 0, a whole row
+        segment at a time
+Input: pointer to Bit2_T bitarr, int x, int y, int width, int height
+Output: none
+*/
+void Bit2_clear_rect(T bitarr, int x, int y, int width, int height)
+{
+        assert(bitarr != NULL);
+        if (x < 0 || y < 0 || width < 0 || height < 0 ||
+            x + width > bitarr->width || y + height > bitarr->height) {
+                RAISE(Bounds);
+        }
+        if (width == 0 || height == 0) {
+                return;
+        }
+        clear_root_rect(bitarr->root, x + bitarr->x0, y + bitarr->y0,
+                        width, height);
+}
+
+/*
+Description: Clears a rectangle given in the coordinates of the array
+        that owns the rows, keeping its occupancy pyramid conservative
+Input: pointer to the owning Bit2_T, int x, int y, int width, int height
+        (not empty and within the array)
+Output: none
+*/
+static void clear_root_rect(T bitarr, int x, int y, int width, int height)
+{
+        /* take the bits about to be cleared off the block counts, looking
+        only inside blocks that have any */
+        for (int j = y; bitarr->counts != NULL && j < y + height; j++) {
+                Bit_T row = row_of(bitarr, j);
+                for (int i = x; i < x + width; ) {
+                        int stop = (i / BIT2_BLOCK1 + 1) * BIT2_BLOCK1;
+                        if (stop > x + width) {
+                                stop = x + width;
+                        }
+                        if (*block_count(bitarr, i, j) != 0) {
+                                int cleared = 0;
+                                for (int k = i; k < stop; k++) {
+                                        cleared += Bit_get(row, k);
+                                }
+                                count_add(bitarr, i, j, -cleared);
+                        }
+                        i = stop;
+                }
+        }
+        for (int j = y; j < y + height; j++) {
+                /* a shared row cleared whole becomes the blank row
+                rather than a copy that is then cleared */
+                if (width == bitarr->width && row_shared(bitarr, j)) {
+                        *(Bit_T *)UArray_at(bitarr->spine, j) =
+                                Seq_get(bitarr->pool, 0);
+                        continue;
+                }
+                Bit_clear(row_for_write(bitarr, j), x, x + width - 1);
+        }
+        /* with every row cleared no row holds a pooled Bit_T but the
+        blank row, so the rest are freed rather than kept until
+        Bit2_free while the array is reused image after image */
+        if (bitarr->pool != NULL && width == bitarr->width &&
+            height == bitarr->height) {
+                while (Seq_length(bitarr->pool) > 1) {
+                        Bit_T row = Seq_remhi(bitarr->pool);
+                        Bit_free(&row);
+                }
+        }
+        if (bitarr->any[0] == NULL) {
+                return;
+        }
+
+        for (int level = 0; level < BIT2_LEVELS; level++) {
+                int size = Bit2_block_size(level);
+                int right = x + width;
+                int bottom = y + height;
+                for (int by = y / size; by <= (bottom - 1) / size; by++) {
+                        Bit_T all_row = row_of(bitarr->all[level], by);
+                        Bit_T any_row = row_of(bitarr->any[level], by);
+                        Bit_clear(all_row, x / size, (right - 1) / size);
+
+                        /* blocks entirely inside the rectangle are now
+                        blank; edge blocks are clipped to the image */
+                        int top = by * size;
+                        int end = top + size;
+                        if (end > bitarr->height) {
+                                end = bitarr->height;
+                        }
+                        if (top < y || end > bottom) {
+                                continue;
+                        }
+                        for (int bx = x / size; bx <= (right - 1) / size;
+                             bx++) {
+                                int left = bx * size;
+                                int stop = left + size;
+                                if (stop > bitarr->width) {
+                                        stop = bitarr->width;
+                                }
+                                if (left >= x && stop <= right) {
+                                        Bit_put(any_row, bx, 0);
+                                }
+                        }
+                }
+        }
+}
+
+/*
+Description: Builds (or rebuilds) the occupancy pyramid of bitarr.
+        Rows that are entirely 0 or entirely 1 are summarised from
+        their bit count alone; only mixed rows are scanned bit by bit.
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_pyramid_build(T bitarr)
+{
+        assert(bitarr != NULL);
+        if (bitarr->root != bitarr) {
+                RAISE(View);
+        }
+        Bit2_pyramid_free(bitarr);
+
+        int bw = (bitarr->width + BIT2_BLOCK0 - 1) / BIT2_BLOCK0;
+        int bh = (bitarr->height + BIT2_BLOCK0 - 1) / BIT2_BLOCK0;
+        if (bw == 0 || bh == 0) {
+                return;
+        }
+        T any = Bit2_new(bw, bh);
+        T all = Bit2_new(bw, bh);
+        for (int by = 0; by < bh; by++) {
+                Bit_set(row_of(all, by), 0, bw - 1);
+        }
+
+        for (int y = 0; y < bitarr->height; y++) {
+                Bit_T row = row_of(bitarr, y);
+                Bit_T any_row = row_of(any, y / BIT2_BLOCK0);
+                Bit_T all_row = row_of(all, y / BIT2_BLOCK0);
+                int count = Bit_count(row);
+                if (count == 0) {
+                        Bit_clear(all_row, 0, bw - 1);
+                        continue;
+                }
+                if (count == bitarr->width) {
+                        Bit_set(any_row, 0, bw - 1);
+                        continue;
+                }
+                for (int x = 0; x < bitarr->width; x++) {
+                        if (Bit_get(row, x)) {
+                                Bit_put(any_row, x / BIT2_BLOCK0, 1);
+                        } else {
+                                Bit_put(all_row, x / BIT2_BLOCK0, 0);
+                        }
+                }
+        }
+        bitarr->any[0] = any;
+        bitarr->all[0] = all;
+
+        /* each higher level is the OR / AND of the level below it */
+        for (int level = 1; level < BIT2_LEVELS; level++) {
+                int factor = Bit2_block_size(level) /
+                             Bit2_block_size(level - 1);
+                T below_any = bitarr->any[level - 1];
+                T below_all = bitarr->all[level - 1];
+                int lw = (below_any->width + factor - 1) / factor;
+                int lh = (below_any->height + factor - 1) / factor;
+                any = Bit2_new(lw, lh);
+                all = Bit2_new(lw, lh);
+                for (int by = 0; by < lh; by++) {
+                        Bit_set(row_of(all, by), 0, lw - 1);
+                }
+                for (int y = 0; y < below_any->height; y++) {
+                        Bit_T any_row = row_of(any, y / factor);
+                        Bit_T all_row = row_of(all, y / factor);
+                        Bit_T below_any_row = row_of(below_any, y);
+                        Bit_T below_all_row = row_of(below_all, y);
+                        for (int x = 0; x < below_any->width; x++) {
+                                if (Bit_get(below_any_row, x)) {
+                                        Bit_put(any_row, x / factor, 1);
+                                }
+                                if (!Bit_get(below_all_row, x)) {
+                                        Bit_put(all_row, x / factor, 0);
+                                }
+                        }
+                }
+                bitarr->any[level] = any;
+                bitarr->all[level] = all;
+        }
+}
+
+/*
+Description: Frees the occupancy pyramid of bitarr, if it has one
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_pyramid_free(T bitarr)
+{
+        assert(bitarr != NULL);
+        for (int level = 0; level < BIT2_LEVELS; level++) {
+                if (bitarr->any[level] != NULL) {
+                        Bit2_free(&bitarr->any[level]);
+                        Bit2_free(&bitarr->all[level]);
+                        bitarr->any[level] = NULL;
+                        bitarr->all[level] = NULL;
+                }
+        }
+}
+
+/*
+Description: Returns whether bitarr currently has an occupancy pyramid
+Input: pointer to Bit2_T bitarr
+Output: 1 if the pyramid is built, 0 otherwise
+*/
+int Bit2_has_pyramid(T bitarr)
+{
+        assert(bitarr != NULL);
+        return bitarr->any[0] != NULL;
+}
+
+/*
+Description: Returns the side length in pixels of the blocks of the
+        given pyramid level
+Input: int level (0 to BIT2_LEVELS - 1)
+Output: (int) the block size
+*/
+int Bit2_block_size(int level)
+{
+        assert(level >= 0 && level < BIT2_LEVELS);
+        return level == 0 ? BIT2_BLOCK0 : BIT2_BLOCK1;
+}
+
+/*
+Description: Returns whether the block at column bx, row by of the given
+        pyramid level may contain a 1 bit
+Input: pointer to Bit2_T bitarr, int level, int bx, int by
+Output: 0 if the block is certainly blank, 1 otherwise
+*/
+int Bit2_block_any(T bitarr, int level, int bx, int by)
+{
+        assert(bitarr != NULL && level >= 0 && level < BIT2_LEVELS);
+        if (bitarr->any[level] == NULL) {
+                return 1;
+        }
+        return Bit2_get(bitarr->any[level], bx, by);
+}
+
+/*
+Description: Returns whether every bit of the block at column bx, row by
+        of the given pyramid level is certainly 1
+Input: pointer to Bit2_T bitarr, int level, int bx, int by
+Output: 1 if the block is full, 0 otherwise
+*/
+int Bit2_block_all(T bitarr, int level, int bx, int by)
+{
+        assert(bitarr != NULL && level >= 0 && level < BIT2_LEVELS);
+        if (bitarr->all[level] == NULL) {
+                return 0;
+        }
+        return Bit2_get(bitarr->all[level], bx, by);
+}
+
+/*
+Description: Makes a copy of bitarr, a whole row at a time
+Input: pointer to Bit2_T bitarr
+Output: a pointer to the new Bit2_T
+*/
+T Bit2_copy(T bitarr)
+{
+        assert(bitarr != NULL);
+        T copy = Bit2_new(bitarr->width, bitarr->height);
+        for (int y = 0; y < bitarr->height; y++) {
+                if (!full_width(bitarr)) {
+                        Bit_T src = row_of(bitarr, y);
+                        Bit_T dst = row_of(copy, y);
+                        for (int x = 0; x < bitarr->width; x++) {
+                                Bit_put(dst, x, Bit_get(src,
+                                                        x + bitarr->x0));
+                        }
+                        continue;
+                }
+                Bit_T *row_arr = UArray_at(copy->spine, y);
+                Bit_free(row_arr);
+                /* the union of a row with itself is a fresh copy of it */
+                *row_arr = Bit_union(row_of(bitarr, y), row_of(bitarr, y));
+        }
+        return copy;
+}
+
+/*
+Description: Makes the transpose of bitarr one BIT2_BLOCK1 square tile at
+        a time, skipping blank rows and blank pyramid tiles
+Input: pointer to Bit2_T bitarr
+Output: a pointer to the new height * width Bit2_T
+*/
+T Bit2_transpose(T bitarr)
+{
+        assert(bitarr != NULL);
+        T result = Bit2_new(bitarr->height, bitarr->width);
+        Bit_T dst[BIT2_BLOCK1];
+        char *blank = malloc(bitarr->height + 1);
+        if (blank == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        for (int y = 0; y < bitarr->height; y++) {
+                blank[y] = span_count(bitarr, y) == 0;
+        }
+
+        for (int tx = 0; tx < bitarr->width; tx += BIT2_BLOCK1) {
+                int tw = bitarr->width - tx < BIT2_BLOCK1 ?
+                         bitarr->width - tx : BIT2_BLOCK1;
+                for (int i = 0; i < tw; i++) {
+                        dst[i] = row_of(result, tx + i);
+                }
+                for (int ty = 0; ty < bitarr->height; ty += BIT2_BLOCK1) {
+                        if (!Bit2_block_any(bitarr, 1, tx / BIT2_BLOCK1,
+                                            ty / BIT2_BLOCK1)) {
+                                continue;
+                        }
+                        int th = bitarr->height - ty < BIT2_BLOCK1 ?
+                                 bitarr->height - ty : BIT2_BLOCK1;
+                        for (int y = ty; y < ty + th; y++) {
+                                if (blank[y]) {
+                                        continue;
+                                }
+                                Bit_T src = row_of(bitarr, y);
+                                for (int i = 0; i < tw; i++) {
+                                        if (Bit_get(src,
+                                                    bitarr->x0 + tx + i)) {
+                                                Bit_put(dst[i], y, 1);
+                                        }
+                                }
+                        }
+                }
+        }
+        free(blank);
+        return result;
+}
+
+/*
+Description: Makes a copy of bitarr rotated clockwise by the given angle:
+        90 is a transpose and a horizontal flip, 270 a transpose and a
+        vertical flip and 180 a copy flipped both ways
+Input: pointer to Bit2_T bitarr, int degrees (a multiple of 90)
+Output: a pointer to the new Bit2_T
+*/
+T Bit2_rotate(T bitarr, int degrees)
+{
+        assert(bitarr != NULL);
+        if (degrees % 90 != 0) {
+                RAISE(Bounds);
+        }
+        degrees = ((degrees % 360) + 360) % 360;
+        T result;
+        if (degrees == 90 || degrees == 270) {
+                result = Bit2_transpose(bitarr);
+                if (degrees == 90) {
+                        Bit2_flip_horizontal(result);
+                } else {
+                        Bit2_flip_vertical(result);
+                }
+        } else {
+                result = Bit2_copy(bitarr);
+                if (degrees == 180) {
+                        Bit2_flip_horizontal(result);
+                        Bit2_flip_vertical(result);
+                }
+        }
+        return result;
+}
+
+/*
+Description: Mirrors bitarr in place so its left column becomes its
+        right column, skipping rows that are blank
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_flip_horizontal(T bitarr)
+{
+        assert(bitarr != NULL);
+        Bit2_pyramid_free(bitarr->root);
+        for (int y = 0; y < bitarr->height; y++) {
+                int count = span_count(bitarr, y);
+                if (count == 0 || count == bitarr->width) {
+                        continue;
+                }
+                Bit_T row = row_for_write(bitarr, y);
+                int l = bitarr->x0;
+                int r = bitarr->x0 + bitarr->width - 1;
+                for (; l < r; l++, r--) {
+                        int left = Bit_get(row, l);
+                        Bit_put(row, l, Bit_put(row, r, left));
+                }
+        }
+        recount(bitarr->root);
+}
+
+/*
+Description: Mirrors bitarr in place so its top row becomes its bottom
+        row by swapping the Bit_T of each pair of rows
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_flip_vertical(T bitarr)
+{
+        assert(bitarr != NULL);
+        Bit2_pyramid_free(bitarr->root);
+        for (int t = 0, b = bitarr->height - 1; t < b; t++, b--) {
+                if (!full_width(bitarr)) {
+                        /* a narrow view shares its rows with pixels
+                        outside it, so its bits are swapped instead */
+                        Bit_T top = row_for_write(bitarr, t);
+                        Bit_T bottom = row_for_write(bitarr, b);
+                        for (int x = bitarr->x0;
+                             x < bitarr->x0 + bitarr->width; x++) {
+                                Bit_put(top, x, Bit_put(bottom, x,
+                                                        Bit_get(top, x)));
+                        }
+                        continue;
+                }
+                Bit_T *top = UArray_at(bitarr->spine, t + bitarr->y0);
+                Bit_T *bottom = UArray_at(bitarr->spine, b + bitarr->y0);
+                Bit_T temp = *top;
+                *top = *bottom;
+                *bottom = temp;
+                /* whether a row is shared moves with its Bit_T */
+                Bit_T shared = bitarr->root->shared;
+                if (shared != NULL) {
+                        Bit_put(shared, t + bitarr->y0,
+                                Bit_put(shared, b + bitarr->y0,
+                                        Bit_get(shared, t + bitarr->y0)));
+                }
+        }
+        recount(bitarr->root);
+}
+
+/*
+Description: Same traversal as Bit2_map_col_major, but walks the rows of
+        a transposed copy of bitarr
+Input: A pointer to a Bit2 bitarr, an apply function of type
+        void, a pointer to a closure
+Output: nothing
+*/
+void Bit2_map_col_major_transposed(T bitarr,
+        void apply(int width, int height, T bitarr, int b, void *p1), void *cl)
+{
+        if(bitarr == NULL) {
+                assert(0);
+        }
+
+        T transposed = Bit2_transpose(bitarr);
+        for(int i = 0; i < transposed->height; i++) {
+                Bit_T row = row_of(transposed, i);
+                for(int j = 0; j < transposed->width; j++) {
+                        apply(i, j, bitarr, Bit_get(row, j), cl);
+                }
+        }
+        Bit2_free(&transposed);
+}
+
+/*
+Description: Starts keeping a count of the 1 bits in every BIT2_BLOCK1
+        square block of bitarr, updated by Bit2_put and the bulk
+        operations as the bits change
+Input: pointer to Bit2_T bitarr (not a view)
+Output: none
+*/
+void Bit2_track_counts(T bitarr)
+{
+        assert(bitarr != NULL);
+        if (bitarr->root != bitarr) {
+                RAISE(View);
+        }
+        if (bitarr->counts != NULL) {
+                return;
+        }
+        int cols = (bitarr->width + BIT2_BLOCK1 - 1) / BIT2_BLOCK1;
+        int rows = (bitarr->height + BIT2_BLOCK1 - 1) / BIT2_BLOCK1;
+        bitarr->count_cols = cols;
+        bitarr->counts = UArray_new(cols * rows, sizeof(int));
+        bitarr->band_counts = UArray_new(rows, sizeof(int));
+        recount(bitarr);
+}
+
+/*
+Description: Returns whether every bit of a rectangle of bitarr is 0.
+        With block counts, blocks counted empty are skipped and a
+        counted block lying wholly inside the rectangle answers at once.
+Input: pointer to Bit2_T bitarr, int x, int y, int width, int height
+Output: 1 if the rectangle is blank, 0 otherwise
+*/
+int Bit2_region_empty(T bitarr, int x, int y, int width, int height)
+{
+        assert(bitarr != NULL);
+        if (x < 0 || y < 0 || width < 0 || height < 0 ||
+            x + width > bitarr->width || y + height > bitarr->height) {
+                RAISE(Bounds);
+        }
+        T root = bitarr->root;
+        x += bitarr->x0;
+        y += bitarr->y0;
+        for (int j = y; j < y + height; j++) {
+                Bit_T row = row_of(root, j);
+                for (int i = x; i < x + width; ) {
+                        int stop = (i / BIT2_BLOCK1 + 1) * BIT2_BLOCK1;
+                        if (stop > x + width) {
+                                stop = x + width;
+                        }
+                        if (root->counts != NULL) {
+                                int left = i / BIT2_BLOCK1 * BIT2_BLOCK1;
+                                int top = j / BIT2_BLOCK1 * BIT2_BLOCK1;
+                                int count = *block_count(root, i, j);
+                                if (count == 0) {
+                                        i = stop;
+                                        continue;
+                                }
+                                if (left >= x && top >= y &&
+                                    left + BIT2_BLOCK1 <= x + width &&
+                                    top + BIT2_BLOCK1 <= y + height) {
+                                        return 0;
+                                }
+                        }
+                        for (; i < stop; i++) {
+                                if (Bit_get(row, i)) {
+                                        return 0;
+                                }
+                        }
+                }
+        }
+        return 1;
+}
+
+/*
+Description: Finds the first 1 bit of bitarr at or after (*x, *y) in
+        row major order. With block counts, rows of blocks and blocks
+        counted empty are jumped over.
+Input: pointer to Bit2_T bitarr, pointers to the int x and y to start
+        from (an x past the end of the row starts at the next row)
+Output: 1, with *x and *y set to the bit found, or 0 if there is none
+*/
+int Bit2_next_black(T bitarr, int *x, int *y)
+{
+        assert(bitarr != NULL && x != NULL && y != NULL);
+        T root = bitarr->root;
+        int left = bitarr->x0;
+        int right = bitarr->x0 + bitarr->width;
+        int bottom = bitarr->y0 + bitarr->height;
+        int start = *x < 0 ? left : *x + left;
+        for (int j = (*y < 0 ? 0 : *y) + bitarr->y0; j < bottom;
+             j++, start = left) {
+                if (root->counts != NULL &&
+                    *(int *)UArray_at(root->band_counts,
+                                      j / BIT2_BLOCK1) == 0) {
+                        j = (j / BIT2_BLOCK1 + 1) * BIT2_BLOCK1 - 1;
+                        continue;
+                }
+                Bit_T row = row_of(root, j);
+                for (int i = start; i < right; ) {
+                        int stop = (i / BIT2_BLOCK1 + 1) * BIT2_BLOCK1;
+                        if (stop > right) {
+                                stop = right;
+                        }
+                        if (root->counts != NULL &&
+                            *block_count(root, i, j) == 0) {
+                                i = stop;
+                                continue;
+                        }
+                        for (; i < stop; i++) {
+                                if (Bit_get(row, i)) {
+                                        *x = i - left;
+                                        *y = j - bitarr->y0;
+                                        return 1;
+                                }
+                        }
+                }
+        }
+        return 0;
+}
+
+/*
+Description: Writes bitarr to fp in the native format. The rows are
+        packed into memory first so that the tile index, which comes
+        before them in the file, can be worked out from the packed bytes.
+Input: pointer to Bit2_T bitarr, file pointer, int index
+Output: none
+*/
+void Bit2_save(T bitarr, FILE *fp, int index)
+{
+        assert(bitarr != NULL && fp != NULL);
+        long row_bytes = ((bitarr->width + 7) / 8 + BIT2_ALIGN - 1) /
+                         BIT2_ALIGN * BIT2_ALIGN;
+        int tile_cols = (bitarr->width + BIT2_BLOCK1 - 1) / BIT2_BLOCK1;
+        int tile_rows = (bitarr->height + BIT2_BLOCK1 - 1) / BIT2_BLOCK1;
+        long tiles = index ? (long)tile_cols * tile_rows : 0;
+        long index_room = (tiles + BIT2_ALIGN - 1) / BIT2_ALIGN * BIT2_ALIGN;
+
+        unsigned char *data = calloc(bitarr->height * row_bytes + 1, 1);
+        unsigned char *kinds = calloc(index_room + 1, 1);
+        if (data == NULL || kinds == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        for (int y = 0; y < bitarr->height; y++) {
+                if (y > 0 && Bit2_same_row(bitarr, y, y - 1)) {
+                        memcpy(data + y * row_bytes,
+                               data + (y - 1) * row_bytes, row_bytes);
+                        continue;
+                }
+                pack_row(bitarr, y, data + y * row_bytes);
+        }
+        for (long i = 0; i < tiles; i++) {
+                kinds[i] = tile_kind(data, row_bytes, i % tile_cols,
+                                     i / tile_cols, bitarr->width,
+                                     bitarr->height);
+        }
+
+        unsigned char head[BIT2_ALIGN] = { 'B', 'I', 'T', '2' };
+        put_le(head + 4, BIT2_VERSION, 4);
+        put_le(head + 8, bitarr->width, 4);
+        put_le(head + 12, bitarr->height, 4);
+        put_le(head + 16, row_bytes, 4);
+        put_le(head + 20, index ? BIT2_BLOCK1 : 0, 4);
+        put_le(head + 24, index ? BIT2_ALIGN : 0, 8);
+        put_le(head + 32, BIT2_ALIGN + index_room, 8);
+        fwrite(head, 1, BIT2_ALIGN, fp);
+        fwrite(kinds, 1, index_room, fp);
+        fwrite(data, 1, bitarr->height * row_bytes, fp);
+        free(data);
+        free(kinds);
+}
+
+/*
+Description: Reads one native format image from fp a row at a time
+        into a scratch row, filling uniform tiles from the index and
+        decoding the rest, and putting each into an array from
+        Bit2_new_shared so that blank and repeated rows are never
+        allocated
+Input: file pointer
+Output: a pointer to the new Bit2_T
+*/
+T Bit2_load(FILE *fp)
+{
+        assert(fp != NULL);
+        unsigned char head[BIT2_ALIGN];
+        if (fread(head, 1, BIT2_ALIGN, fp) != BIT2_ALIGN) {
+                RAISE(Format);
+        }
+        struct header h = parse_header(head);
+        int tile_cols = h.tile ? (h.width + h.tile - 1) / h.tile : 0;
+        long tiles = h.tile ? (long)tile_cols *
+                     ((h.height + h.tile - 1) / h.tile) : 0;
+        if (tiles > 0 && (h.index_offset < BIT2_ALIGN ||
+                          h.index_offset + tiles > h.data_offset)) {
+                RAISE(Format);
+        }
+        unsigned char *kinds = malloc(tiles + 1);
+        unsigned char *bytes = malloc(h.row_bytes + 1);
+        if (kinds == NULL || bytes == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        /* fp may be a pipe, so the gaps are read over, not sought past */
+        long pos = BIT2_ALIGN;
+        if (tiles > 0) {
+                for (; pos < h.index_offset; pos++) {
+                        getc(fp);
+                }
+                if (fread(kinds, 1, tiles, fp) != (size_t)tiles) {
+                        RAISE(Format);
+                }
+                pos += tiles;
+        }
+        for (; pos < h.data_offset; pos++) {
+                getc(fp);
+        }
+
+        T bitarr = Bit2_new_shared(h.width, h.height);
+        Bit_T row = Bit_new(h.width);
+        for (int y = 0; y < h.height; y++) {
+                if (fread(bytes, 1, h.row_bytes, fp) != (size_t)h.row_bytes) {
+                        RAISE(Format);
+                }
+                Bit_clear(row, 0, h.width - 1);
+                if (tiles > 0) {
+                        unpack_tiles(row, 0, bytes,
+                                     kinds + y / h.tile * tile_cols,
+                                     0, h.width);
+                } else {
+                        unpack_bits(row, 0, bytes, 0, h.width);
+                }
+                Bit2_put_row(bitarr, y, row);
+        }
+        Bit_free(&row);
+        free(kinds);
+        free(bytes);
+        return bitarr;
+}
+
+/*
+Description: Maps the native format file at path and decodes only the
+        asked for rectangle of it
+Input: the file's path, int x, int y, int width, int height
+Output: a pointer to the new width * height Bit2_T
+*/
+T Bit2_load_rect(const char *path, int x, int y, int width, int height)
+{
+        assert(path != NULL);
+        int fd = open(path, O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < BIT2_ALIGN) {
+                if (fd >= 0) {
+                        close(fd);
+                }
+                RAISE(Format);
+        }
+        unsigned char *file = mmap(NULL, info.st_size, PROT_READ,
+                                   MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (file == MAP_FAILED) {
+                RAISE(Format);
+        }
+        struct header h = parse_header(file);
+        int tile_cols = h.tile ? (h.width + h.tile - 1) / h.tile : 0;
+        long tiles = h.tile ? (long)tile_cols *
+                     ((h.height + h.tile - 1) / h.tile) : 0;
+        if (h.data_offset + h.height * h.row_bytes > info.st_size ||
+            (tiles > 0 && h.index_offset + tiles > info.st_size)) {
+                munmap(file, info.st_size);
+                RAISE(Format);
+        }
+        if (x < 0 || y < 0 || width < 0 || height < 0 ||
+            x + width > h.width || y + height > h.height) {
+                munmap(file, info.st_size);
+                RAISE(Bounds);
+        }
+
+        T bitarr = Bit2_new_shared(width, height);
+        Bit_T scratch = Bit_new(width);
+        /* with no columns every row is already the (empty) blank row */
+        for (int row = 0; width > 0 && row < height; row++) {
+                const unsigned char *bytes = file + h.data_offset +
+                                             (y + row) * h.row_bytes;
+                Bit_clear(scratch, 0, width - 1);
+                if (tiles > 0) {
+                        unpack_tiles(scratch, x, bytes,
+                                     file + h.index_offset +
+                                     (y + row) / h.tile * tile_cols,
+                                     x, x + width);
+                } else {
+                        unpack_bits(scratch, x, bytes, x, x + width);
+                }
+                Bit2_put_row(bitarr, row, scratch);
+        }
+        Bit_free(&scratch);
+        munmap(file, info.st_size);
+        return bitarr;
+}
+
+/*
+Description: Lets row y share the Bit_T of an identical row: the blank
+        row of the array when it has no 1 bits, or else row y - 1. The
+        row's own Bit_T is freed.
+Input: pointer to Bit2_T bitarr (not a view), int y
+Output: 1 if the row is now shared, 0 if it was left alone
+*/
+int Bit2_share_row(T bitarr, int y)
+{
+        assert(bitarr != NULL);
+        if (bitarr->root != bitarr) {
+                RAISE(View);
+        }
+        if (y < 0 || y >= bitarr->height) {
+                RAISE(Bounds);
+        }
+        if (bitarr->pool == NULL) {
+                start_sharing(bitarr);
+        }
+        Bit_T target = share_target(bitarr, y, row_of(bitarr, y));
+        if (target == NULL) {
+                return 0;
+        }
+        point_row(bitarr, y, target);
+        return 1;
+}
+
+/*
+Description: Makes row y of bitarr equal to row, sharing it when it is
+        blank or repeats row y - 1 and otherwise giving it a copy of its
+        own. Changed bits are passed on to the pyramid and block counts.
+Input: pointer to Bit2_T bitarr (not a view), int y, the Bit_T row
+Output: 1 if the row is now shared, 0 if it has its own Bit_T
+*/
+int Bit2_put_row(T bitarr, int y, Bit_T row)
+{
+        assert(bitarr != NULL && row != NULL);
+        if (bitarr->root != bitarr) {
+                RAISE(View);
+        }
+        if (y < 0 || y >= bitarr->height ||
+            Bit_length(row) != bitarr->width) {
+                RAISE(Bounds);
+        }
+        if (bitarr->pool == NULL) {
+                start_sharing(bitarr);
+        }
+        Bit_T old = row_of(bitarr, y);
+        for (int x = 0; (bitarr->counts != NULL || bitarr->any[0] != NULL)
+                        && x < bitarr->width; x++) {
+                int bit = Bit_get(row, x);
+                if (Bit_get(old, x) == bit) {
+                        continue;
+                }
+                if (bitarr->any[0] != NULL) {
+                        pyramid_mark(bitarr, x, y, bit);
+                }
+                if (bitarr->counts != NULL) {
+                        count_add(bitarr, x, y, bit ? 1 : -1);
+                }
+        }
+        Bit_T target = share_target(bitarr, y, row);
+        if (target != NULL) {
+                point_row(bitarr, y, target);
+                return 1;
+        }
+        if (!row_shared(bitarr, y)) {
+                Bit_free(&old);
+        }
+        /* the union of a row with itself is a fresh copy of it */
+        *(Bit_T *)UArray_at(bitarr->spine, y) = Bit_union(row, row);
+        Bit_put(bitarr->shared, y, 0);
+        return 0;
+}
+
+/*
+Description: Returns how many Bit_Ts hold the rows of the array owning
+        bitarr: one per row with its own and one per shared Bit_T
+Input: pointer to Bit2_T bitarr
+Output: the number of Bit_Ts (int)
+*/
+int Bit2_row_buffers(T bitarr)
+{
+        assert(bitarr != NULL);
+        T root = bitarr->root;
+        if (root->pool == NULL) {
+                return root->height;
+        }
+        return root->height - Bit_count(root->shared) +
+               Seq_length(root->pool);
+}
+
+/*
+Description: Returns whether rows y1 and y2 of bitarr are held in the
+        same shared Bit_T, which tells without reading them that they
+        are equal
+Input: pointer to Bit2_T bitarr, int y1, int y2
+Output: 1 if they share their bits, 0 if not (they may still be equal)
+*/
+int Bit2_same_row(T bitarr, int y1, int y2)
+{
+        assert(bitarr != NULL);
+        if (y1 < 0 || y2 < 0 || y1 >= bitarr->height ||
+            y2 >= bitarr->height) {
+                RAISE(Bounds);
+        }
+        return row_of(bitarr, y1) == row_of(bitarr, y2);
+}
+
+/*
+Description: Returns the Bit_T holding row y of bitarr, without the
+        bounds check done by Bit2_get
+Input: pointer to Bit2_T bitarr, int y
+Output: the Bit_T of that row
+*/
+static Bit_T row_of(T bitarr, int y)
+{
+        Bit_T *row_arr = UArray_at(bitarr->spine, y + bitarr->y0);
+        return *row_arr;
+}
+
+/*
+Description: Returns the Bit_T holding row y of bitarr for changing it,
+        first giving the row a copy of its own if it is shared
+Input: pointer to Bit2_T bitarr, int y
+Output: the Bit_T of that row, owned by that row alone
+*/
+static Bit_T row_for_write(T bitarr, int y)
+{
+        Bit_T *row_arr = UArray_at(bitarr->spine, y + bitarr->y0);
+        if (row_shared(bitarr, y)) {
+                /* the union of a row with itself is a fresh copy of it */
+                *row_arr = Bit_union(*row_arr, *row_arr);
+                Bit_put(bitarr->root->shared, y + bitarr->y0, 0);
+        }
+        return *row_arr;
+}
+
+/*
+Description: Returns whether row y of bitarr is held in a shared Bit_T
+Input: pointer to Bit2_T bitarr, int y
+Output: 1 if it is shared, 0 otherwise
+*/
+static int row_shared(T bitarr, int y)
+{
+        return bitarr->root->shared != NULL &&
+               Bit_get(bitarr->root->shared, y + bitarr->y0);
+}
+
+/*
+Description: Sets up row sharing in the array bitarr owning its rows:
+        no row shared yet and a pool holding just the blank row
+Input: pointer to the owning Bit2_T
+Output: none
+*/
+static void start_sharing(T bitarr)
+{
+        bitarr->shared = Bit_new(bitarr->height);
+        bitarr->pool = Seq_new(0);
+        Seq_addhi(bitarr->pool, Bit_new(bitarr->width));
+}
+
+/*
+Description: Finds the shared Bit_T that row y of bitarr can take for
+        the bits in row: the blank row when row has no 1 bits, or else
+        row y - 1 when it is equal, which is then made shared too
+Input: pointer to the owning Bit2_T (sharing started), int y, the bits
+        of the row
+Output: the Bit_T to share, or NULL if there is none
+*/
+static Bit_T share_target(T bitarr, int y, Bit_T row)
+{
+        if (Bit_count(row) == 0) {
+                return Seq_get(bitarr->pool, 0);
+        }
+        if (y == 0 || !Bit_eq(row, row_of(bitarr, y - 1))) {
+                return NULL;
+        }
+        Bit_T above = row_of(bitarr, y - 1);
+        if (!row_shared(bitarr, y - 1)) {
+                Seq_addhi(bitarr->pool, above);
+                Bit_put(bitarr->shared, y - 1, 1);
+        }
+        return above;
+}
+
+/*
+Description: Points row y of bitarr at the shared Bit_T target, freeing
+        the row's own Bit_T if it had one
+Input: pointer to the owning Bit2_T, int y, the shared Bit_T
+Output: none
+*/
+static void point_row(T bitarr, int y, Bit_T target)
+{
+        Bit_T *row_arr = UArray_at(bitarr->spine, y);
+        if (*row_arr == target) {
+                return;
+        }
+        if (!row_shared(bitarr, y)) {
+                Bit_free(row_arr);
+        }
+        *row_arr = target;
+        Bit_put(bitarr->shared, y, 1);
+}
+
+/*
+Description: Returns whether bitarr covers whole rows of the array that
+        owns them, so that whole-row Bit_T operations apply to it
+Input: pointer to Bit2_T bitarr
+Output: 1 if it does, 0 otherwise
+*/
+static int full_width(T bitarr)
+{
+        return bitarr->x0 == 0 && bitarr->width == bitarr->root->width;
+}
+
+/*
+Description: Counts the 1 bits of row y of bitarr, with one Bit_count
+        when bitarr covers the whole row
+Input: pointer to Bit2_T bitarr, int y
+Output: (int) the number of 1 bits in the row
+*/
+static int span_count(T bitarr, int y)
+{
+        Bit_T row = row_of(bitarr, y);
+        if (full_width(bitarr)) {
+                return Bit_count(row);
+        }
+        int count = 0;
+        for (int x = bitarr->x0; x < bitarr->x0 + bitarr->width; x++) {
+                count += Bit_get(row, x);
+        }
+        return count;
+}
+
+/*
+Description: Sets up the fields of a new array that owns its rows
+Input: pointer to the new Bit2_T, its width and height
+Output: none
+*/
+static void init_fields(T bitarr, int width, int height)
+{
+        bitarr->height = height;
+        bitarr->width = width;
+        for (int level = 0; level < BIT2_LEVELS; level++) {
+                bitarr->any[level] = NULL;
+                bitarr->all[level] = NULL;
+        }
+        bitarr->root = bitarr;
+        bitarr->x0 = 0;
+        bitarr->y0 = 0;
+        bitarr->counts = NULL;
+        bitarr->band_counts = NULL;
+        bitarr->count_cols = 0;
+        bitarr->shared = NULL;
+        bitarr->pool = NULL;
+}
+
+/*
+Description: Returns a pointer to the count of the block holding bit
+        x, y of the owning array bitarr
+Input: pointer to the owning Bit2_T, int x, int y
+Output: pointer to the block's count
+*/
+static int *block_count(T bitarr, int x, int y)
+{
+        int index = y / BIT2_BLOCK1 * bitarr->count_cols + x / BIT2_BLOCK1;
+        return UArray_at(bitarr->counts, index);
+}
+
+/*
+Description: Adds delta to the count of the block (and row of blocks)
+        holding bit x, y of the owning array bitarr
+Input: pointer to the owning Bit2_T, int x, int y, int delta
+Output: none
+*/
+static void count_add(T bitarr, int x, int y, int delta)
+{
+        *block_count(bitarr, x, y) += delta;
+        *(int *)UArray_at(bitarr->band_counts, y / BIT2_BLOCK1) += delta;
+}
+
+/*
+Description: Recomputes the block counts of the owning array bitarr from
+        its bits, if it tracks them. Blank rows are skipped with a single
+        Bit_count and full rows are added a block at a time.
+Input: pointer to the owning Bit2_T
+Output: none
+*/
+static void recount(T bitarr)
+{
+        if (bitarr->counts == NULL) {
+                return;
+        }
+        for (int i = 0; i < UArray_length(bitarr->counts); i++) {
+                *(int *)UArray_at(bitarr->counts, i) = 0;
+        }
+        for (int i = 0; i < UArray_length(bitarr->band_counts); i++) {
+                *(int *)UArray_at(bitarr->band_counts, i) = 0;
+        }
+        for (int y = 0; y < bitarr->height; y++) {
+                Bit_T row = row_of(bitarr, y);
+                int count = Bit_count(row);
+                if (count == 0) {
+                        continue;
+                }
+                for (int x = 0; x < bitarr->width; x += BIT2_BLOCK1) {
+                        int stop = x + BIT2_BLOCK1 < bitarr->width ?
+                                   x + BIT2_BLOCK1 : bitarr->width;
+                        int ones = 0;
+                        if (count == bitarr->width) {
+                                ones = stop - x;
+                        } else {
+                                for (int k = x; k < stop; k++) {
+                                        ones += Bit_get(row, k);
+                                }
+                        }
+                        count_add(bitarr, x, y, ones);
+                }
+        }
+}
+
+/*
+Description: Thread body for Bit2_new_large that allocates the rows of
+        one band, so their memory is first touched by this thread
+Input: a pointer to the band struct
+Output: NULL
+*/
+static void *make_band(void *cl)
+{
+        struct band *band = cl;
+        for (int i = band->first; i < band->last; i++) {
+                Bit_T *row_arr = UArray_at(band->bitarr->spine, i);
+                *row_arr = Bit_new(band->bitarr->width);
+        }
+        return NULL;
+}
+
+/*
+Description: Keeps the occupancy pyramid conservative after a single
+        bit of bitarr is put: a 1 makes its blocks possibly non-blank
+        and a 0 makes them no longer full
+Input: pointer to Bit2_T bitarr, int x, int y, the bit that was put
+Output: none
+*/
+static void pyramid_mark(T bitarr, int x, int y, int thisBit)
+{
+        for (int level = 0; level < BIT2_LEVELS; level++) {
+                int size = Bit2_block_size(level);
+                if (thisBit) {
+                        Bit_put(row_of(bitarr->any[level], y / size),
+                                x / size, 1);
+                } else {
+                        Bit_put(row_of(bitarr->all[level], y / size),
+                                x / size, 0);
+                }
+        }
+}
+
+/*
+Description: Packs row y of bitarr into bytes, 8 pixels to a byte with
+        the leftmost in the high bit, reading nothing from a blank row
+Input: pointer to Bit2_T bitarr, int y, the zeroed bytes to fill
+Output: none
+*/
+static void pack_row(T bitarr, int y, unsigned char *bytes)
+{
+        int count = span_count(bitarr, y);
+        if (count == 0) {
+                return;
+        }
+        Bit_T row = row_of(bitarr, y);
+        for (int x = 0; x < bitarr->width; x++) {
+                if (count == bitarr->width ||
+                    Bit_get(row, x + bitarr->x0)) {
+                        bytes[x / 8] |= 0x80 >> (x % 8);
+                }
+        }
+}
+
+/*
+Description: Sets the bits of row for the 1 bits of packed bytes from
+        pixel lo up to (not including) pixel hi, one Bit_set per run
+        of 1s and stepping over zero bytes whole. Pixel p of the bytes
+        goes to bit p - x0 of row.
+Input: the Bit_T row, int x0, the packed bytes, int lo, int hi
+Output: none
+*/
+static void unpack_bits(Bit_T row, int x0, const unsigned char *bytes,
+                        int lo, int hi)
+{
+        int start = -1;
+        for (int p = lo; p < hi; p++) {
+                if (start < 0 && p % 8 == 0 && bytes[p / 8] == 0) {
+                        p += 7;
+                        continue;
+                }
+                int bit = (bytes[p / 8] >> (7 - p % 8)) & 1;
+                if (bit && start < 0) {
+                        start = p;
+                } else if (!bit && start >= 0) {
+                        Bit_set(row, start - x0, p - 1 - x0);
+                        start = -1;
+                }
+        }
+        if (start >= 0) {
+                Bit_set(row, start - x0, hi - 1 - x0);
+        }
+}
+
+/*
+Description: Like unpack_bits, but takes each tile's span of the row
+        from the tile index first: white tiles are skipped, black tiles
+        set with one Bit_set and only mixed tiles are decoded
+Input: the Bit_T row, int x0, the packed bytes, the index bytes of the
+        row of tiles holding this row, int lo, int hi
+Output: none
+*/
+static void unpack_tiles(Bit_T row, int x0, const unsigned char *bytes,
+                         const unsigned char *tiles, int lo, int hi)
+{
+        for (int p = lo; p < hi; ) {
+                int stop = (p / BIT2_BLOCK1 + 1) * BIT2_BLOCK1;
+                stop = stop < hi ? stop : hi;
+                switch (tiles[p / BIT2_BLOCK1]) {
+                case BIT2_TILE_WHITE:
+                        break;
+                case BIT2_TILE_BLACK:
+                        Bit_set(row, p - x0, stop - 1 - x0);
+                        break;
+                default:
+                        unpack_bits(row, x0, bytes, p, stop);
+                        break;
+                }
+                p = stop;
+        }
+}
+
+/*
+Description: Works out whether the tile at column tx, row ty of packed
+        rows is all white, all black or mixed
+Input: the packed rows, the bytes per row, int tx, int ty, the image's
+        width and height
+Output: BIT2_TILE_WHITE, BIT2_TILE_BLACK or BIT2_TILE_MIXED
+*/
+static int tile_kind(const unsigned char *data, long row_bytes, int tx,
+                     int ty, int width, int height)
+{
+        int x = tx * BIT2_BLOCK1;
+        int stop_x = x + BIT2_BLOCK1 < width ? x + BIT2_BLOCK1 : width;
+        int stop_y = (ty + 1) * BIT2_BLOCK1 < height ?
+                     (ty + 1) * BIT2_BLOCK1 : height;
+        int ones = 0;
+        int zeros = 0;
+        for (int y = ty * BIT2_BLOCK1; y < stop_y; y++) {
+                const unsigned char *bytes = data + y * row_bytes;
+                for (int p = x; p < stop_x; p++) {
+                        /* whole bytes first, the tile's last one may be
+                        cut short by the edge of the image */
+                        if (p % 8 == 0 && p + 8 <= stop_x) {
+                                ones += bytes[p / 8] != 0;
+                                zeros += bytes[p / 8] != 0xff;
+                                p += 7;
+                        } else if ((bytes[p / 8] >> (7 - p % 8)) & 1) {
+                                ones++;
+                        } else {
+                                zeros++;
+                        }
+                }
+                if (ones > 0 && zeros > 0) {
+                        return BIT2_TILE_MIXED;
+                }
+        }
+        return ones == 0 ? BIT2_TILE_WHITE : BIT2_TILE_BLACK;
+}
+
+/*
+Description: Stores value in size bytes, lowest byte first
+Input: the bytes to fill, the value, int size
+Output: none
+*/
+static void put_le(unsigned char *bytes, uint64_t value, int size)
+{
+        for (int i = 0; i < size; i++) {
+                bytes[i] = (value >> (8 * i)) & 0xff;
+        }
+}
+
+/*
+Description: Reads a number stored in size bytes, lowest byte first
+Input: the bytes, int size
+Output: the value
+*/
+static uint64_t get_le(const unsigned char *bytes, int size)
+{
+        uint64_t value = 0;
+        for (int i = size - 1; i >= 0; i--) {
+                value = (value << 8) | bytes[i];
+        }
+        return value;
+}
+
+/*
+Description: Reads and checks the fields of a native format header,
+        raising Format if it is not one this version can read or if the
+        image is empty, as empty PBM input is refused too
+Input: the BIT2_ALIGN header bytes
+Output: the header's fields
+*/
+static struct header parse_header(const unsigned char *bytes)
+{
+        struct header h;
+        if (memcmp(bytes, "BIT2", 4) != 0 ||
+            get_le(bytes + 4, 4) != BIT2_VERSION) {
+                RAISE(Format);
+        }
+        h.width = get_le(bytes + 8, 4);
+        h.height = get_le(bytes + 12, 4);
+        h.row_bytes = get_le(bytes + 16, 4);
+        h.tile = get_le(bytes + 20, 4);
+        h.index_offset = get_le(bytes + 24, 8);
+        h.data_offset = get_le(bytes + 32, 8);
+        if (h.width <= 0 || h.height <= 0 ||
+            h.row_bytes < (h.width + 7) / 8 ||
+            (h.tile != 0 && h.tile != BIT2_BLOCK1) ||
+            h.data_offset < BIT2_ALIGN) {
+                RAISE(Format);
+        }
+        return h;
+}
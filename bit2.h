@@ -1,9 +1,42 @@
 #ifndef BIT2
 #define BIT2
+#include <stdio.h>
+#include <bit.h>
 #define T Bit2_T
 
 typedef struct T *T;
 
+/*
+The occupancy pyramid summarises the bit array in square blocks:
+level 0 blocks are BIT2_BLOCK0 pixels on a side and level 1 blocks
+are BIT2_BLOCK1 pixels on a side
+*/
+#define BIT2_LEVELS 2
+#define BIT2_BLOCK0 8
+#define BIT2_BLOCK1 64
+
+/*
+The native file format, all numbers little endian:
+        bytes 0-3       the magic "BIT2"
+        bytes 4-7       version, BIT2_VERSION
+        bytes 8-15      width and height in pixels
+        bytes 16-19     bytes per row, a multiple of BIT2_ALIGN
+        bytes 20-23     tile size of the index, BIT2_BLOCK1, or 0 when
+                        the file has no index
+        bytes 24-31     offset of the tile index (0 for none)
+        bytes 32-39     offset of the rows, a multiple of BIT2_ALIGN
+        bytes 40-63     zero
+The index holds one byte per BIT2_BLOCK1 square tile, row major, telling
+whether the tile is mixed, all white or all black. Each row holds its
+pixels 8 to a byte, leftmost pixel in the high bit as in raw PBM, padded
+with 0 bits to the row size.
+*/
+#define BIT2_VERSION 1
+#define BIT2_ALIGN 64
+#define BIT2_TILE_MIXED 0
+#define BIT2_TILE_WHITE 1
+#define BIT2_TILE_BLACK 2
+
 /*
 Description: Creates a new Bit2 array of size height * width
 Input: the height (int) and width (int) of the new Bit2_T
@@ -11,6 +44,46 @@ Output: a pointer to a Bit2_T array
 */
 T Bit2_new(int width, int height);
 
+/*
+Description: Creates a new Bit2 array of size height * width for very
+        large images: nthreads threads each allocate and zero the rows
+        of one band, so that under first-touch NUMA placement every
+        band lives on the node of the thread that made it
+Input: the width (int), height (int) and number of threads (int)
+Output: a pointer to a Bit2_T array
+*/
+T Bit2_new_large(int width, int height, int nthreads);
+
+/*
+Description: Creates a new Bit2 array of size height * width for reading
+        an image into: every row starts out sharing the array's one
+        blank row, so the array holds a single row of storage until rows
+        are put into it with Bit2_put_row (or changed, which copies them)
+Input: the width (int) and height (int) of the new Bit2_T
+Output: a pointer to a Bit2_T array
+*/
+T Bit2_new_shared(int width, int height);
+
+/*
+Description: Makes a view of the rectangle of bitarr with top left
+        corner (x, y) and the given width and height. The view shares
+        bitarr's bits, so nothing is copied: every Bit2 function takes
+        a view, with coordinates and bounds relative to the view, and
+        changes made through it are changes to bitarr. Freeing a view
+        frees only the view; it must not outlive the array it is of.
+        A view has no occupancy pyramid of its own.
+Input: pointer to Bit2_T bitarr, int x, int y, int width, int height
+Output: a pointer to the view
+*/
+T Bit2_view(T bitarr, int x, int y, int width, int height);
+
+/*
+Description: Returns whether bitarr is a view of another Bit2_T
+Input: pointer to Bit2_T bitarr
+Output: 1 if it is a view, 0 if it owns its bits
+*/
+int Bit2_is_view(T bitarr);
+
 /*
 Description: Returns the height of the Bit2_T array pointed
         to by the bit bitarr
@@ -74,6 +147,245 @@ void Bit2_map_col_major(T bitarr,
     void apply(int width, int height, T bitarr, int b, void *p1), void *cl);
 
 
+/*
+Description: Returns the number of 1 bits in the Bit2_T array, by
+        adding up the block counts when bitarr keeps them and otherwise
+        skipping blank blocks when the occupancy pyramid is built
+Input: pointer to Bit2_T bitarr
+Output: (int) the number of 1 bits
+*/
+int Bit2_count(T bitarr);
+
+/*
+Description: Starts keeping a count of the 1 bits in every BIT2_BLOCK1
+        square block of bitarr. Unlike the occupancy pyramid the counts
+        are exact: Bit2_put, Bit2_clear_rect and the in-place flips keep
+        them up to date as the bits change (including through views),
+        so Bit2_count, Bit2_region_empty and Bit2_next_black can skip
+        empty blocks without scanning them. Does nothing if bitarr
+        already keeps counts; it is a checked runtime error to call it
+        on a view.
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_track_counts(T bitarr);
+
+/*
+Description: Returns whether every bit of the rectangle with top left
+        corner (x, y) and the given width and height is 0
+Input: pointer to Bit2_T bitarr, int x, int y, int width, int height
+Output: 1 if the rectangle is blank, 0 otherwise
+*/
+int Bit2_region_empty(T bitarr, int x, int y, int width, int height);
+
+/*
+Description: Finds the first 1 bit of bitarr at or after (*x, *y) in
+        row major order
+Input: pointer to Bit2_T bitarr, pointers to the int x and y to start
+        from (an x past the end of a row starts at the next row)
+Output: 1, with *x and *y set to the bit found, or 0 if there is none
+*/
+int Bit2_next_black(T bitarr, int *x, int *y);
+
+/*
+Description: Finds the smallest rectangle holding every 1 bit of bitarr.
+        Rows are tested with whole-row bit counts and columns with the
+        union of the non-blank rows, so only that one union row is
+        walked bit by bit.
+Input: pointer to Bit2_T bitarr, pointers to ints that get the x, y,
+        width and height of the rectangle
+Output: 1 if bitarr has a 1 bit, 0 (leaving the ints alone) if it is blank
+*/
+int Bit2_bbox(T bitarr, int *x, int *y, int *width, int *height);
+
+/*
+Description: Sets every bit of the rectangle with top left corner
+        (x, y) and the given width and height to 0, a whole row
+        segment at a time
+Input: pointer to Bit2_T bitarr, int x, int y, int width, int height
+Output: none
+*/
+void Bit2_clear_rect(T bitarr, int x, int y, int width, int height);
+
+/*
+Description: Builds (or rebuilds) the occupancy pyramid of bitarr, which
+        records for every block of each level whether any of its bits
+        are 1 and whether all of them are. Once built, Bit2_put and the
+        bulk operations keep it conservative: a block reported blank is
+        always blank and a block reported full is always full. Changes
+        made through views of bitarr keep it conservative too. It is a
+        checked runtime error to build the pyramid of a view.
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_pyramid_build(T bitarr);
+
+/*
+Description: Frees the occupancy pyramid of bitarr, if it has one
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_pyramid_free(T bitarr);
+
+/*
+Description: Returns whether bitarr currently has an occupancy pyramid
+Input: pointer to Bit2_T bitarr
+Output: 1 if the pyramid is built, 0 otherwise
+*/
+int Bit2_has_pyramid(T bitarr);
+
+/*
+Description: Returns the side length in pixels of the blocks of the
+        given pyramid level
+Input: int level (0 to BIT2_LEVELS - 1)
+Output: (int) the block size
+*/
+int Bit2_block_size(int level);
+
+/*
+Description: Returns whether the block at column bx, row by of the given
+        pyramid level may contain a 1 bit. Returns 1 when bitarr has no
+        pyramid.
+Input: pointer to Bit2_T bitarr, int level, int bx, int by
+Output: 0 if the block is certainly blank, 1 otherwise
+*/
+int Bit2_block_any(T bitarr, int level, int bx, int by);
+
+/*
+Description: Returns whether every bit of the block at column bx, row by
+        of the given pyramid level is certainly 1. Returns 0 when bitarr
+        has no pyramid.
+Input: pointer to Bit2_T bitarr, int level, int bx, int by
+Output: 1 if the block is full, 0 otherwise
+*/
+int Bit2_block_all(T bitarr, int level, int bx, int by);
+
+/*
+Description: Makes a copy of bitarr, a whole row at a time. The copy has
+        no occupancy pyramid.
+Input: pointer to Bit2_T bitarr
+Output: a pointer to the new Bit2_T
+*/
+T Bit2_copy(T bitarr);
+
+/*
+Description: Makes the transpose of bitarr (bit x, y of bitarr becomes
+        bit y, x of the result), working through the image in
+        BIT2_BLOCK1 square tiles so the rows being written stay in cache
+Input: pointer to Bit2_T bitarr
+Output: a pointer to the new height * width Bit2_T
+*/
+T Bit2_transpose(T bitarr);
+
+/*
+Description: Makes a copy of bitarr rotated clockwise by the given angle
+Input: pointer to Bit2_T bitarr, int degrees (a multiple of 90)
+Output: a pointer to the new Bit2_T
+*/
+T Bit2_rotate(T bitarr, int degrees);
+
+/*
+Description: Mirrors bitarr in place so its left column becomes its
+        right column. Drops the occupancy pyramid.
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_flip_horizontal(T bitarr);
+
+/*
+Description: Mirrors bitarr in place so its top row becomes its bottom
+        row, by swapping rows rather than bits. Drops the occupancy
+        pyramid.
+Input: pointer to Bit2_T bitarr
+Output: none
+*/
+void Bit2_flip_vertical(T bitarr);
+
+/*
+Description: Same traversal as Bit2_map_col_major, but walks the rows of
+        a transposed copy of bitarr instead of reading bits one by one
+        across rows. The apply function still gets bitarr and its
+        coordinates; bits it changes are not seen by later calls.
+Input: A pointer to a Bit2 bitarr, an apply function of type
+        void, a pointer to a closure
+Output: nothing
+*/
+void Bit2_map_col_major_transposed(T bitarr,
+    void apply(int width, int height, T bitarr, int b, void *p1), void *cl);
+
+/*
+Description: Lets row y share its storage with an identical row, so
+        that runs of equal rows (blank, or all black in the margins) are
+        held once: a blank row shares the array's one blank row, any
+        other row shares row y - 1 when the two are equal. Shared rows
+        are copied on their first change, so sharing is never seen
+        through the rest of the interface.
+Input: pointer to Bit2_T bitarr (not a view), int y
+Output: 1 if the row is now shared, 0 if it was left alone
+*/
+int Bit2_share_row(T bitarr, int y);
+
+/*
+Description: Makes row y of bitarr equal to row, a Bit_T as wide as
+        bitarr that the caller keeps. The row is shared as by
+        Bit2_share_row when it is blank or equal to row y - 1, and only
+        otherwise given a Bit_T of its own. Readers fill each row of an
+        image into one scratch Bit_T and put it here, so that an array
+        from Bit2_new_shared never allocates the rows it shares.
+Input: pointer to Bit2_T bitarr (not a view), int y, the Bit_T row
+Output: 1 if the row is now shared, 0 if it has its own Bit_T
+*/
+int Bit2_put_row(T bitarr, int y, Bit_T row);
+
+/*
+Description: Returns how many Bit_Ts hold the rows of bitarr (of the
+        array owning them, for a view): one for each row with a Bit_T
+        of its own and one for each shared Bit_T, the blank row among
+        them once rows have been shared. Clearing the whole array frees
+        every shared Bit_T but the blank row.
+Input: pointer to Bit2_T bitarr
+Output: the number of Bit_Ts (int)
+*/
+int Bit2_row_buffers(T bitarr);
+
+/*
+Description: Returns whether rows y1 and y2 of bitarr share their
+        storage, and so are certainly equal, in constant time. Writers
+        use it to repeat the output of a row rather than format it again.
+Input: pointer to Bit2_T bitarr, int y1, int y2
+Output: 1 if they share their storage, 0 if not (they may still be equal)
+*/
+int Bit2_same_row(T bitarr, int y1, int y2);
+
+/*
+Description: Writes bitarr to fp in the native format, with a tile index
+        when asked for one. Views are written like any other array.
+Input: pointer to Bit2_T bitarr, file pointer, int index (nonzero to
+        write the tile index)
+Output: none
+*/
+void Bit2_save(T bitarr, FILE *fp, int index);
+
+/*
+Description: Reads one image in the native format from fp, leaving fp
+        just past its last row. Tiles the index marks as uniform are
+        filled without decoding their bytes, and blank and repeated rows
+        are shared as by Bit2_put_row.
+Input: file pointer
+Output: a pointer to the new Bit2_T
+*/
+T Bit2_load(FILE *fp);
+
+/*
+Description: Reads only the rectangle with top left corner (x, y) and
+        the given width and height of the native format file at path.
+        The file is mapped rather than read, so only the pages holding
+        the rows (and, with an index, the mixed tiles) asked for are
+        touched.
+Input: the file's path, int x, int y, int width, int height
+Output: a pointer to the new width * height Bit2_T
+*/
+T Bit2_load_rect(const char *path, int x, int y, int width, int height);
 
 #undef T
 #endif
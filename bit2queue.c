@@ -0,0 +1,137 @@
+/*
+                bit2queue.c
+
+        This is the implementation of the Bit2queue_T, a bounded
+        blocking queue that lets the reader, fill and writer threads
+        of unblackedges hand images to one another
+
+        Authors: Kenneth Xue (kxue01)
+                Alyssa Rose (arose10)
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <except.h>
+#include <assert.h>
+#include "bit2queue.h"
+
+#define T Bit2queue_T
+
+struct Bit2queue_T {
+        Bit2_T *images;
+        int capacity;
+        int head;
+        int length;
+        bool closed;
+        pthread_mutex_t lock;
+        pthread_cond_t not_empty;
+        pthread_cond_t not_full;
+};
+
+static Except_T Bad_Alloc = { "Could not allocate memory" };
+
+/*
+Description: Creates a new bounded queue used to hand Bit2_T images
+        from one thread to another
+Input: the number of images (int) the queue may hold before
+        Bit2queue_put blocks
+Output: a pointer to a Bit2queue_T
+*/
+T Bit2queue_new(int capacity)
+{
+        assert(capacity > 0);
+        T queue = malloc(sizeof(struct Bit2queue_T));
+        if (queue == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        queue->images = malloc(capacity * sizeof(Bit2_T));
+        if (queue->images == NULL) {
+                free(queue);
+                RAISE(Bad_Alloc);
+        }
+        queue->capacity = capacity;
+        queue->head = 0;
+        queue->length = 0;
+        queue->closed = false;
+        pthread_mutex_init(&queue->lock, NULL);
+        pthread_cond_init(&queue->not_empty, NULL);
+        pthread_cond_init(&queue->not_full, NULL);
+        return queue;
+}
+
+/*
+Description: Adds an image to the back of the queue, waiting until
+        there is room if the queue is full
+Input: pointer to a Bit2queue_T, the Bit2_T image to hand off
+Output: none
+*/
+void Bit2queue_put(T queue, Bit2_T image)
+{
+        assert(queue != NULL && image != NULL);
+        pthread_mutex_lock(&queue->lock);
+        assert(!queue->closed);
+        while (queue->length == queue->capacity) {
+                pthread_cond_wait(&queue->not_full, &queue->lock);
+        }
+        int tail = (queue->head + queue->length) % queue->capacity;
+        queue->images[tail] = image;
+        queue->length++;
+        pthread_cond_signal(&queue->not_empty);
+        pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+Description: Removes the image at the front of the queue, waiting
+        until one is available
+Input: pointer to a Bit2queue_T
+Output: the next Bit2_T image, or NULL once the queue is closed and empty
+*/
+Bit2_T Bit2queue_get(T queue)
+{
+        assert(queue != NULL);
+        pthread_mutex_lock(&queue->lock);
+        while (queue->length == 0 && !queue->closed) {
+                pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+        Bit2_T image = NULL;
+        if (queue->length > 0) {
+                image = queue->images[queue->head];
+                queue->head = (queue->head + 1) % queue->capacity;
+                queue->length--;
+                pthread_cond_signal(&queue->not_full);
+        }
+        pthread_mutex_unlock(&queue->lock);
+        return image;
+}
+
+/*
+Description: Marks that no more images will be put on the queue and
+        wakes every thread waiting for an image
+Input: pointer to a Bit2queue_T
+Output: none
+*/
+void Bit2queue_close(T queue)
+{
+        assert(queue != NULL);
+        pthread_mutex_lock(&queue->lock);
+        queue->closed = true;
+        pthread_cond_broadcast(&queue->not_empty);
+        pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+Description: Frees the queue pointed to by *queue
+Input: A pointer to a Bit2queue_T pointer
+Output: nothing
+*/
+void Bit2queue_free(T *queue)
+{
+        assert(queue != NULL && *queue != NULL);
+        pthread_mutex_destroy(&(*queue)->lock);
+        pthread_cond_destroy(&(*queue)->not_empty);
+        pthread_cond_destroy(&(*queue)->not_full);
+        free((*queue)->images);
+        free(*queue);
+        *queue = NULL;
+}
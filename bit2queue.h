@@ -0,0 +1,51 @@
+#ifndef BIT2QUEUE
+#define BIT2QUEUE
+#include "bit2.h"
+#define T Bit2queue_T
+
+typedef struct T *T;
+
+/*
+Description: Creates a new bounded queue used to hand Bit2_T images
+        from one thread to another
+Input: the number of images (int) the queue may hold before
+        Bit2queue_put blocks (2 for double buffering, 3 for triple)
+Output: a pointer to a Bit2queue_T
+*/
+T Bit2queue_new(int capacity);
+
+/*
+Description: Adds an image to the back of the queue, waiting until
+        there is room if the queue is full
+Input: pointer to a Bit2queue_T, the Bit2_T image to hand off
+Output: none
+*/
+void Bit2queue_put(T queue, Bit2_T image);
+
+/*
+Description: Removes the image at the front of the queue, waiting
+        until one is available
+Input: pointer to a Bit2queue_T
+Output: the next Bit2_T image, or NULL once the queue has been
+        closed and every image in it has been taken
+*/
+Bit2_T Bit2queue_get(T queue);
+
+/*
+Description: Marks that no more images will be put on the queue so
+        that waiting consumers see the end of the stream
+Input: pointer to a Bit2queue_T
+Output: none
+*/
+void Bit2queue_close(T queue);
+
+/*
+Description: Frees the queue pointed to by *queue. Any images still
+        in the queue are not freed.
+Input: A pointer to a Bit2queue_T pointer
+Output: nothing
+*/
+void Bit2queue_free(T *queue);
+
+#undef T
+#endif
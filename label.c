@@ -0,0 +1,317 @@
+/*
+                label.c
+
+        This is the implementation of the Label_T, a two pass
+        connected component labeler over a Bit2_T built on runs
+        of black pixels and union-find
+
+        Authors: Kenneth Xue (kxue01)
+                Alyssa Rose (arose10)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <except.h>
+#include <uarray.h>
+#include <assert.h>
+#include "label.h"
+
+#define T Label_T
+
+/*
+Struct holding one horizontal run of black pixels: the row it is on,
+its first and last columns, and its union-find parent (a run index)
+*/
+struct run {
+        int y, x0, x1;
+        int parent;
+};
+
+struct Label_T {
+        UArray2_T map;
+        UArray_T runs;
+        int nruns;
+        UArray_T stats;
+        int count;
+};
+
+static Except_T Bad_Alloc = { "Could not allocate memory" };
+static Except_T Bad_Connectivity = { "Connectivity must be 4 or 8" };
+
+static int find_runs(T labels, Bit2_T image, int y);
+static struct run *run_at(T labels, int i);
+static int find(T labels, int i);
+static void join(T labels, int a, int b);
+
+/*
+Description: Labels the connected components of black pixels in image
+Input: a Bit2_T image, the connectivity (4 or 8)
+Output: a pointer to a Label_T
+*/
+T Label_new(Bit2_T image, int connectivity)
+{
+        if (connectivity != 4 && connectivity != 8) {
+                RAISE(Bad_Connectivity);
+        }
+        T labels = malloc(sizeof(struct Label_T));
+        if (labels == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        int width = Bit2_width(image);
+        int height = Bit2_height(image);
+        labels->runs = UArray_new(64, sizeof(struct run));
+        labels->nruns = 0;
+        labels->count = 0;
+
+        /* two runs on neighbouring rows touch if their column ranges
+        overlap, or for 8-connectivity are one column apart */
+        int reach = (connectivity == 8) ? 1 : 0;
+        int above = 0;
+        int above_end = 0;
+        for (int y = 0; y < height; y++) {
+                int start = labels->nruns;
+                int end = find_runs(labels, image, y);
+                int j = above;
+                for (int i = start; i < end; i++) {
+                        struct run *r = run_at(labels, i);
+                        while (j < above_end &&
+                               run_at(labels, j)->x1 + reach < r->x0) {
+                                j++;
+                        }
+                        for (int k = j; k < above_end; k++) {
+                                struct run *a = run_at(labels, k);
+                                if (a->x0 > r->x1 + reach) {
+                                        break;
+                                }
+                                join(labels, k, i);
+                        }
+                }
+                above = start;
+                above_end = end;
+        }
+
+        /* second pass: number the roots and gather their statistics */
+        labels->map = UArray2_new(width, height, sizeof(int));
+        labels->stats = UArray_new(1, sizeof(struct Label_stats));
+        int *run_label = malloc((labels->nruns + 1) * sizeof(int));
+        if (run_label == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        for (int i = 0; i < labels->nruns; i++) {
+                struct run *r = run_at(labels, i);
+                int root = find(labels, i);
+                int label;
+                struct Label_stats *stats;
+                if (root == i) {
+                        label = ++labels->count;
+                        UArray_resize(labels->stats, label + 1);
+                        stats = UArray_at(labels->stats, label);
+                        stats->area = 0;
+                        stats->min_x = r->x0;
+                        stats->max_x = r->x1;
+                        stats->min_y = r->y;
+                        stats->max_y = r->y;
+                        stats->edges = 0;
+                } else {
+                        label = run_label[root];
+                        stats = UArray_at(labels->stats, label);
+                }
+
+                stats->area += r->x1 - r->x0 + 1;
+                if (r->x0 < stats->min_x) {
+                        stats->min_x = r->x0;
+                }
+                if (r->x1 > stats->max_x) {
+                        stats->max_x = r->x1;
+                }
+                stats->max_y = r->y;
+                if (r->y == 0) {
+                        stats->edges |= LABEL_TOP;
+                }
+                if (r->y == height - 1) {
+                        stats->edges |= LABEL_BOTTOM;
+                }
+                if (r->x0 == 0) {
+                        stats->edges |= LABEL_LEFT;
+                }
+                if (r->x1 == width - 1) {
+                        stats->edges |= LABEL_RIGHT;
+                }
+
+                run_label[i] = label;
+                for (int x = r->x0; x <= r->x1; x++) {
+                        *(int *)UArray2_at(labels->map, x, r->y) = label;
+                }
+        }
+
+        /* remember each run's label so Label_erase needs no finds */
+        for (int i = 0; i < labels->nruns; i++) {
+                run_at(labels, i)->parent = run_label[i];
+        }
+        free(run_label);
+        return labels;
+}
+
+/*
+Description: Returns the number of components found
+Input: pointer to a Label_T
+Output: (int) the number of components
+*/
+int Label_count(T labels)
+{
+        assert(labels != NULL);
+        return labels->count;
+}
+
+/*
+Description: Returns the label map of the components
+Input: pointer to a Label_T
+Output: the UArray2_T label map
+*/
+UArray2_T Label_map(T labels)
+{
+        assert(labels != NULL);
+        return labels->map;
+}
+
+/*
+Description: Returns the statistics of the component with the given label
+Input: pointer to a Label_T, int label (1 to Label_count)
+Output: pointer to that component's Label_stats
+*/
+struct Label_stats *Label_get(T labels, int label)
+{
+        assert(labels != NULL && label >= 1 && label <= labels->count);
+        return UArray_at(labels->stats, label);
+}
+
+/*
+Description: Sets to white every component of image for which select
+        returns true, clearing it a run at a time
+Input: pointer to a Label_T, the Bit2_T image, a select function, a
+        pointer to a closure
+Output: the number of components cleared
+*/
+int Label_erase(T labels, Bit2_T image,
+        int select(int label, struct Label_stats *stats, void *cl), void *cl)
+{
+        assert(labels != NULL && image != NULL);
+        char *chosen = calloc(labels->count + 1, 1);
+        if (chosen == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        int erased = 0;
+        for (int label = 1; label <= labels->count; label++) {
+                if (select(label, Label_get(labels, label), cl)) {
+                        chosen[label] = 1;
+                        erased++;
+                }
+        }
+        for (int i = 0; erased > 0 && i < labels->nruns; i++) {
+                struct run *r = run_at(labels, i);
+                if (chosen[r->parent]) {
+                        Bit2_clear_rect(image, r->x0, r->y,
+                                        r->x1 - r->x0 + 1, 1);
+                }
+        }
+        free(chosen);
+        return erased;
+}
+
+/*
+Description: Frees the Label_T pointed to by *labels and its label map
+Input: A pointer to a Label_T pointer
+Output: nothing
+*/
+void Label_free(T *labels)
+{
+        assert(labels != NULL && *labels != NULL);
+        UArray2_free(&(*labels)->map);
+        UArray_free(&(*labels)->runs);
+        UArray_free(&(*labels)->stats);
+        free(*labels);
+        *labels = NULL;
+}
+
+/*
+Description: Appends the runs of black pixels on row y of image to the
+        run list, stepping over blank pyramid blocks when the image
+        has a pyramid
+Input: pointer to a Label_T, a Bit2_T image, int y
+Output: the index one past the last run of the row
+*/
+static int find_runs(T labels, Bit2_T image, int y)
+{
+        int width = Bit2_width(image);
+        int x = 0;
+        while (x < width) {
+                if (x % BIT2_BLOCK0 == 0 &&
+                    !Bit2_block_any(image, 0, x / BIT2_BLOCK0,
+                                    y / BIT2_BLOCK0)) {
+                        x += BIT2_BLOCK0;
+                        continue;
+                }
+                if (!Bit2_get(image, x, y)) {
+                        x++;
+                        continue;
+                }
+                int x0 = x;
+                while (x < width && Bit2_get(image, x, y)) {
+                        x++;
+                }
+                if (labels->nruns == UArray_length(labels->runs)) {
+                        UArray_resize(labels->runs, 2 * labels->nruns);
+                }
+                struct run *r = run_at(labels, labels->nruns);
+                r->y = y;
+                r->x0 = x0;
+                r->x1 = x - 1;
+                r->parent = labels->nruns;
+                labels->nruns++;
+        }
+        return labels->nruns;
+}
+
+/*
+Description: Returns the run with index i
+Input: pointer to a Label_T, int i
+Output: pointer to the run
+*/
+static struct run *run_at(T labels, int i)
+{
+        return UArray_at(labels->runs, i);
+}
+
+/*
+Description: Finds the root run of the set holding run i, halving the
+        path to it on the way
+Input: pointer to a Label_T, int i
+Output: the index of the root run
+*/
+static int find(T labels, int i)
+{
+        struct run *r = run_at(labels, i);
+        while (r->parent != i) {
+                struct run *p = run_at(labels, r->parent);
+                r->parent = p->parent;
+                i = r->parent;
+                r = run_at(labels, i);
+        }
+        return i;
+}
+
+/*
+Description: Merges the sets holding runs a and b, keeping the earlier
+        root so that roots are the first run of their component
+Input: pointer to a Label_T, int a, int b
+Output: none
+*/
+static void join(T labels, int a, int b)
+{
+        int ra = find(labels, a);
+        int rb = find(labels, b);
+        if (ra < rb) {
+                run_at(labels, rb)->parent = ra;
+        } else if (rb < ra) {
+                run_at(labels, ra)->parent = rb;
+        }
+}
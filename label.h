@@ -0,0 +1,78 @@
+#ifndef LABEL
+#define LABEL
+#include "bit2.h"
+#include "uarray2.h"
+#define T Label_T
+
+typedef struct T *T;
+
+/* Flags recording which edges of the image a component touches */
+#define LABEL_TOP 1
+#define LABEL_BOTTOM 2
+#define LABEL_LEFT 4
+#define LABEL_RIGHT 8
+
+/*
+Struct holding the statistics of one connected component of black
+pixels: its area, its bounding box and the edges it touches
+*/
+struct Label_stats {
+        int area;
+        int min_x, min_y, max_x, max_y;
+        int edges;
+};
+
+/*
+Description: Labels the connected components of black pixels in image.
+        Each row is split into runs of black pixels, runs that touch
+        in neighbouring rows are merged with union-find, and a second
+        pass gives every component a label from 1 up in the order its
+        first pixel appears in row major order.
+Input: a Bit2_T image, the connectivity (4 or 8)
+Output: a pointer to a Label_T
+*/
+T Label_new(Bit2_T image, int connectivity);
+
+/*
+Description: Returns the number of components found
+Input: pointer to a Label_T
+Output: (int) the number of components
+*/
+int Label_count(T labels);
+
+/*
+Description: Returns the label map: a UArray2_T of ints the size of the
+        image holding 0 for white pixels and the component label of
+        each black pixel. The map belongs to the Label_T.
+Input: pointer to a Label_T
+Output: the UArray2_T label map
+*/
+UArray2_T Label_map(T labels);
+
+/*
+Description: Returns the statistics of the component with the given label
+Input: pointer to a Label_T, int label (1 to Label_count)
+Output: pointer to that component's Label_stats
+*/
+struct Label_stats *Label_get(T labels, int label);
+
+/*
+Description: Sets to white every component of image for which select
+        returns true, clearing it a run at a time. The image must be the
+        one the labels were computed from.
+Input: pointer to a Label_T, the Bit2_T image, a select function given
+        each component's label and statistics, a pointer to a closure
+Output: the number of components cleared
+*/
+int Label_erase(T labels, Bit2_T image,
+        int select(int label, struct Label_stats *stats, void *cl), void *cl);
+
+/*
+Description: Frees the Label_T pointed to by *labels and its label map
+Input: A pointer to a Label_T pointer
+Output: nothing
+*/
+void Label_free(T *labels);
+
+#undef T
+#endif
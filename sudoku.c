@@ -9,6 +9,7 @@
                 Alyssa Rose (arose10)
 */
 #include "uarray2.h"
+#include "uarray2t.h"
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
@@ -65,7 +66,7 @@ UArray2_T init_puzzle(FILE *fp)
         Pnmrdr_T pgm = Pnmrdr_new(fp);
         Pnmrdr_mapdata map_data = Pnmrdr_data(pgm);
         float denom = map_data.denominator;
-        UArray2_T puzzle = UArray2_new(9, 9, sizeof(int));
+        UArray2_T puzzle = UArray2_int_new(9, 9);
         if (map_data.type != 2 || denom != 9 || map_data.height != 9 ||
         map_data.width != 9) {
                 Pnmrdr_free(&pgm);
@@ -82,7 +83,7 @@ UArray2_T init_puzzle(FILE *fp)
                         if (this_pix == 0 || this_pix > 9) {
                             bad_pix = true;
                         }
-                        uarray_val = UArray2_at(puzzle, j, i);
+                        uarray_val = UArray2_int_at(puzzle, j, i);
                         *uarray_val = this_pix;
                 }
         }
@@ -109,8 +110,10 @@ void not_solved(UArray2_T puzzle)
 
 /*
 Description: Function used to determine if a sudoku is solved. Uses row major,
-        cold major, and submap functions to loop through the puzzle,
+        cold major, and submap loops to go through the puzzle,
         and uses our apply function to ensure that a sudoku is solved.
+        The row and col major loops are the typed UArray2 macros, so
+        apply_solve is called directly and can be inlined.
 Input: the UArray2_T representing the Sudoku
 Output: a bool for if it is a solved sudok
 */
@@ -121,8 +124,12 @@ bool is_solved(UArray2_T puzzle)
                 solver[i] = 0;
         }
 
-        UArray2_map_row_major(puzzle, apply_solve, &solver);
-        UArray2_map_col_major(puzzle, apply_solve, &solver);
+        UARRAY2_FOR_ROW_MAJOR(int, puzzle, col, row, elem) {
+                apply_solve(col, row, puzzle, elem, solver);
+        }
+        UARRAY2_FOR_COL_MAJOR(int, puzzle, col, row, elem) {
+                apply_solve(col, row, puzzle, elem, solver);
+        }
         for (int i = 0; i < 9; i+=3) {
                 UArray2_map_submap(puzzle, i, apply_solve, &solver);
         }
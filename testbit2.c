@@ -0,0 +1,194 @@
+/*
+                testbit2.c
+
+        Checks of the Bit2_T interface beyond those in usebit2.c. Each
+        check prints what it tested and whether it passed, and the
+        program exits with a failure status if any check failed.
+
+        Authors: Kenneth Xue (kxue01)
+                Alyssa Rose (arose10)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <except.h>
+#include <bit.h>
+#include <bit2.h>
+
+bool load_refused(int width, int height);
+bool reuse_keeps_pool_small(int images);
+bool fill_image(Bit2_T image, Bit_T row, int seed);
+bool page_buffers(int width, int height, int black, int buffers);
+bool native_blank_buffers(int width, int height);
+void check(const char *what, bool passed);
+
+static bool all_passed = true;
+
+int main(void)
+{
+        check("native file of width 0 is refused", load_refused(0, 2));
+        check("native file of height 0 is refused", load_refused(2, 0));
+        check("native file of 2 x 2 is read", !load_refused(2, 2));
+        check("map reused for 20 images keeps only the blank row shared",
+              reuse_keeps_pool_small(20));
+        check("blank 4000 x 20000 page holds one row",
+              page_buffers(4000, 20000, 0, 1));
+        check("page of one repeated row holds two rows",
+              page_buffers(4000, 20000, 1, 2));
+        check("blank native file is read into one row",
+              native_blank_buffers(4000, 2000));
+
+        return all_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+Description: Saves a blank width * height image in the native format,
+        then reads it back, using a width * height array for the save
+        when both are nonzero and otherwise a 1 x 1 array whose header
+        is patched to the asked for size
+Input: the width and height (int) written in the header
+Output: true if Bit2_load raised an exception, false if it read the file
+*/
+bool load_refused(int width, int height)
+{
+        FILE *fp = tmpfile();
+        Bit2_T image = Bit2_new(width > 0 ? width : 1,
+                                height > 0 ? height : 1);
+        Bit2_save(image, fp, 1);
+        Bit2_free(&image);
+        /* the width and height are little endian at bytes 8 and 12 */
+        unsigned char size[8] = { width & 0xff, width >> 8 & 0xff, 0, 0,
+                                  height & 0xff, height >> 8 & 0xff, 0, 0 };
+        fseek(fp, 8, SEEK_SET);
+        fwrite(size, 1, sizeof(size), fp);
+        rewind(fp);
+
+        volatile bool refused = false;
+        TRY
+                Bit2_T loaded = Bit2_load(fp);
+                Bit2_free(&loaded);
+        ELSE
+                refused = true;
+        END_TRY;
+        fclose(fp);
+        return refused;
+}
+
+/*
+Description: Reads image after image into one map the way unblackedges
+        does, clearing it whole and putting its rows in from a scratch
+        row, and checks that each image is held in the blank row and one
+        row per pair, that each clear leaves just the blank row and that
+        every image reads back as it was written
+Input: the number of images (int)
+Output: true if the map held up for every image, false otherwise
+*/
+bool reuse_keeps_pool_small(int images)
+{
+        Bit2_T image = Bit2_new_shared(64, 64);
+        Bit_T row = Bit_new(64);
+        bool passed = true;
+        for (int seed = 0; seed < images; seed++) {
+                Bit2_clear_rect(image, 0, 0, 64, 64);
+                passed &= Bit2_row_buffers(image) == 1;
+                passed &= fill_image(image, row, seed);
+                passed &= Bit2_row_buffers(image) == 1 + 64 / 2;
+        }
+        Bit_free(&row);
+        Bit2_free(&image);
+        return passed;
+}
+
+/*
+Description: Fills a blank image with rows repeated in pairs, a pattern
+        that changes with seed, putting each row in from row, then reads
+        every pixel back
+Input: a blank 64 x 64 Bit2_T, a scratch Bit_T of 64 bits, the seed
+        (int) of the pattern
+Output: true if every pixel reads back as written, false otherwise
+*/
+bool fill_image(Bit2_T image, Bit_T row, int seed)
+{
+        for (int y = 0; y < 64; y++) {
+                for (int x = 0; x < 64; x++) {
+                        Bit_put(row, x, (x + y / 2 + seed) % 5 == 0);
+                }
+                Bit2_put_row(image, y, row);
+        }
+        bool passed = Bit2_same_row(image, 0, 1);
+        for (int y = 0; y < 64; y++) {
+                for (int x = 0; x < 64; x++) {
+                        passed &= Bit2_get(image, x, y) ==
+                                  ((x + y / 2 + seed) % 5 == 0);
+                }
+        }
+        return passed;
+}
+
+/*
+Description: Reads a page whose rows are all blank, or all the same row
+        with every third pixel black, into a map from Bit2_new_shared
+        with block counts kept, then checks how many row Bit_Ts the map
+        holds and that its counts and bits are right
+Input: the page's width and height (int), whether its rows have black
+        pixels (int), the number of row Bit_Ts it should hold (int)
+Output: true if the map holds that many and reads back right
+*/
+bool page_buffers(int width, int height, int black, int buffers)
+{
+        Bit2_T image = Bit2_new_shared(width, height);
+        Bit2_track_counts(image);
+        Bit_T row = Bit_new(width);
+        for (int x = 0; black && x < width; x += 3) {
+                Bit_put(row, x, 1);
+        }
+        for (int y = 0; y < height; y++) {
+                Bit2_put_row(image, y, row);
+        }
+        bool passed = Bit2_row_buffers(image) == buffers &&
+                      Bit2_count(image) == Bit_count(row) * height &&
+                      Bit2_region_empty(image, 1, 0, 2, height) &&
+                      Bit2_region_empty(image, 0, 0, width, height) ==
+                      !black &&
+                      Bit2_get(image, 0, height - 1) == black;
+        /* a change copies the row, leaving the others shared */
+        Bit2_put(image, 1, height / 2, 1);
+        passed &= Bit2_row_buffers(image) == buffers + 1 &&
+                  Bit2_get(image, 1, height / 2) == 1 &&
+                  Bit2_get(image, 1, height / 2 + 1) == 0;
+        Bit_free(&row);
+        Bit2_free(&image);
+        return passed;
+}
+
+/*
+Description: Saves a blank width * height image in the native format and
+        reads it back, checking that it comes back as the one blank row
+Input: the image's width and height (int)
+Output: true if the loaded image is blank and held in one row Bit_T
+*/
+bool native_blank_buffers(int width, int height)
+{
+        FILE *fp = tmpfile();
+        Bit2_T image = Bit2_new(width, height);
+        Bit2_save(image, fp, 1);
+        Bit2_free(&image);
+        rewind(fp);
+        image = Bit2_load(fp);
+        fclose(fp);
+        bool passed = Bit2_row_buffers(image) == 1 &&
+                      Bit2_count(image) == 0;
+        Bit2_free(&image);
+        return passed;
+}
+
+/*
+Description: Reports the result of one check
+Input: what was checked, whether it passed
+Output: none
+*/
+void check(const char *what, bool passed)
+{
+        printf("%s: %s\n", passed ? "ok" : "FAILED", what);
+        all_passed &= passed;
+}
@@ -0,0 +1,232 @@
+/*
+                trace.c
+
+        This is the implementation of the event tracing used to see
+        where the threads of unblackedges spend their time
+
+        Authors: Kenneth Xue (kxue01)
+                Alyssa Rose (arose10)
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <except.h>
+#include "trace.h"
+
+/*
+Struct holding one recorded event: which stage of which image, whether
+it began ('B') or ended ('E'), and when, in nanoseconds
+*/
+struct event {
+        const char *name;
+        char phase;
+        int image;
+        long long when;
+};
+
+/*
+Struct holding the events of one thread. Only its own thread writes to
+it; the buffers are chained together so they can be written out after
+their threads have finished.
+*/
+struct buffer {
+        struct event events[TRACE_EVENTS];
+        long long count;        /* events recorded, including overwritten */
+        const char *name;
+        int tid;
+        struct buffer *next;
+};
+
+static Except_T Bad_Alloc = { "Could not allocate memory" };
+static Except_T Bad_File = { "Could not write the trace file" };
+
+static const char *trace_path = NULL;
+static long long start;
+static pthread_key_t key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct buffer *buffers = NULL;
+static int nbuffers = 0;
+
+static long long now(void);
+static void make_key(void);
+static struct buffer *own_buffer(void);
+static void record(const char *name, char phase, int image);
+
+/*
+Description: Starts recording events and registers Trace_close to run
+        when the program exits
+Input: the path of the trace file
+Output: none
+*/
+void Trace_open(const char *path)
+{
+        if (path == NULL) {
+                return;
+        }
+        pthread_once(&key_once, make_key);
+        start = now();
+        trace_path = path;
+        atexit(Trace_close);
+}
+
+/*
+Description: Names the calling thread in the trace
+Input: the thread's name
+Output: none
+*/
+void Trace_thread_name(const char *name)
+{
+        if (trace_path == NULL) {
+                return;
+        }
+        own_buffer()->name = name;
+}
+
+/*
+Description: Records the start of a stage of the work on an image
+Input: the stage's name and the number of the image
+Output: none
+*/
+void Trace_begin(const char *name, int image)
+{
+        record(name, 'B', image);
+}
+
+/*
+Description: Records the end of a stage of the work on an image
+Input: the stage's name and the number of the image
+Output: none
+*/
+void Trace_end(const char *name, int image)
+{
+        record(name, 'E', image);
+}
+
+/*
+Description: Writes the events of every thread as a JSON trace, oldest
+        kept event first within each thread, with timestamps in
+        microseconds from Trace_open, then frees the buffers. An end
+        whose begin was overwritten is dropped so viewers still pair
+        every event.
+Input: none
+Output: none
+*/
+void Trace_close(void)
+{
+        if (trace_path == NULL) {
+                return;
+        }
+        FILE *fp = fopen(trace_path, "w");
+        trace_path = NULL;
+        if (fp == NULL) {
+                RAISE(Bad_File);
+        }
+        pthread_mutex_lock(&buffers_lock);
+        fprintf(fp, "{\"traceEvents\":[\n");
+        const char *separator = "";
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                if (b->name != NULL) {
+                        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                                "\"pid\":1,\"tid\":%d,"
+                                "\"args\":{\"name\":\"%s\"}}",
+                                separator, b->tid, b->name);
+                        separator = ",\n";
+                }
+                long long first = b->count > TRACE_EVENTS ?
+                                  b->count - TRACE_EVENTS : 0;
+                int open = 0;
+                for (long long i = first; i < b->count; i++) {
+                        struct event *e = &b->events[i % TRACE_EVENTS];
+                        if (e->phase == 'E' && open == 0) {
+                                continue;
+                        }
+                        open += e->phase == 'B' ? 1 : -1;
+                        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\","
+                                "\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                                "\"args\":{\"image\":%d}}",
+                                separator, e->name, e->phase, b->tid,
+                                (e->when - start) / 1000.0, e->image);
+                        separator = ",\n";
+                }
+        }
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        fclose(fp);
+        while (buffers != NULL) {
+                struct buffer *next = buffers->next;
+                free(buffers);
+                buffers = next;
+        }
+        pthread_mutex_unlock(&buffers_lock);
+}
+
+/*
+Description: Reads the monotonic clock
+Input: none
+Output: the time in nanoseconds
+*/
+static long long now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+Description: Creates the key that finds each thread's buffer
+Input: none
+Output: none
+*/
+static void make_key(void)
+{
+        pthread_key_create(&key, NULL);
+}
+
+/*
+Description: Returns the calling thread's buffer, making and chaining
+        it on the thread's first event. Only this takes the lock.
+Input: none
+Output: pointer to the thread's buffer
+*/
+static struct buffer *own_buffer(void)
+{
+        struct buffer *b = pthread_getspecific(key);
+        if (b != NULL) {
+                return b;
+        }
+        b = malloc(sizeof(struct buffer));
+        if (b == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        b->count = 0;
+        b->name = NULL;
+        pthread_mutex_lock(&buffers_lock);
+        b->tid = ++nbuffers;
+        b->next = buffers;
+        buffers = b;
+        pthread_mutex_unlock(&buffers_lock);
+        pthread_setspecific(key, b);
+        return b;
+}
+
+/*
+Description: Appends an event to the calling thread's buffer, over its
+        oldest event when the buffer is full
+Input: the stage's name, the phase ('B' or 'E'), the image's number
+Output: none
+*/
+static void record(const char *name, char phase, int image)
+{
+        if (trace_path == NULL) {
+                return;
+        }
+        struct buffer *b = own_buffer();
+        struct event *e = &b->events[b->count % TRACE_EVENTS];
+        e->name = name;
+        e->phase = phase;
+        e->image = image;
+        e->when = now();
+        b->count++;
+}
@@ -0,0 +1,50 @@
+#ifndef TRACE
+#define TRACE
+
+/* Number of events each thread keeps; once its buffer is full a thread
+overwrites its oldest events */
+#define TRACE_EVENTS 65536
+
+/*
+Description: Starts recording trace events, which are written to the
+        file at path as Chrome trace-event JSON when the program exits.
+        Until this is called every other Trace function does nothing.
+Input: the path of the trace file
+Output: none
+*/
+void Trace_open(const char *path);
+
+/*
+Description: Names the calling thread in the trace
+Input: the thread's name, a string that must outlive the trace
+Output: none
+*/
+void Trace_thread_name(const char *name);
+
+/*
+Description: Records that the calling thread began a stage of the work
+        on an image. Appending goes to the thread's own buffer, so it
+        takes no lock.
+Input: the stage's name, a string that must outlive the trace, and the
+        number of the image
+Output: none
+*/
+void Trace_begin(const char *name, int image);
+
+/*
+Description: Records that the calling thread ended the stage it most
+        recently began on an image
+Input: the stage's name and the number of the image
+Output: none
+*/
+void Trace_end(const char *name, int image);
+
+/*
+Description: Writes every recorded event to the trace file and stops
+        recording. Trace_open arranges for this to run at exit.
+Input: none
+Output: none
+*/
+void Trace_close(void);
+
+#endif
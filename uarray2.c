@@ -6,71 +6,182 @@
         Authors: Kenneth Xue (kxue01)
                 Alyssa Rose (arose10)
 */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <pthread.h>
 #include <except.h>
 #include "uarray2.h"
-#include <uarray.h>
+#include "uarray2rep.h"
 #include <assert.h>
-#include <except.h>
 
 #define T UArray2_T
 
-struct UArray2_T {
-        UArray_T spine;
-        int col;
-        int row;
-        int size;
+static Except_T Bad_Alloc = { "Could not allocate memory" };
+Except_T UArray2_Bounds = {"Input out of bounds"};
+
+#define CACHE_LINE 64
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+/*
+Struct telling one first-touch thread which bytes of a new block to zero
+*/
+struct band {
+        char *start;
+        size_t length;
 };
 
-static Except_T Bad_Alloc = { "Could not allocate memory" };
-static Except_T Bounds = {"Input out of bounds"};
+static void *touch_band(void *cl);
+static void check_rect(T UArray2, int col, int row, int width, int height);
 
 
 // Does: makes a new UArray2_T with the specified col, row, and size.
+//       Every element starts zeroed; the rows are stored one after
+//       another in a single block.
 // Expects: a positive non-zero col, row, and size.
 //          Expects an output of non-null UArray2 pointer.
 T UArray2_new(int col, int row, int size)
 {
+        assert(col >= 0 && row >= 0 && size > 0);
         T thisArr2 = malloc(sizeof(struct UArray2_T));
         if (thisArr2 == NULL) {
                 RAISE(Bad_Alloc);
         }
-        UArray_T spine = UArray_new(row, sizeof(UArray_T));
+        thisArr2->row = row;
+        thisArr2->col = col;
+        thisArr2->size = size;
+        thisArr2->stride = col * size;
+        thisArr2->elems = calloc((size_t)row * col + 1, size);
+        thisArr2->mapped = 0;
+        thisArr2->is_view = 0;
+        if (thisArr2->elems == NULL) {
+                free(thisArr2);
+                RAISE(Bad_Alloc);
+        }
+        return thisArr2;
+}
 
-        thisArr2->spine = spine;
+// Does: makes a new UArray2_T with cache line aligned rows in a block
+//       mapped with huge pages when possible, zeroed in parallel by
+//       nthreads threads so each band of rows is first touched (and so
+//       placed) by the thread that zeroes it.
+// Expects: a positive non-zero width, height, size, and nthreads.
+//          Expects an output of non-null UArray2 pointer.
+T UArray2_new_large(int col, int row, int size, int nthreads)
+{
+        assert(col >= 0 && row >= 0 && size > 0 && nthreads > 0);
+        T thisArr2 = malloc(sizeof(struct UArray2_T));
+        if (thisArr2 == NULL) {
+                RAISE(Bad_Alloc);
+        }
         thisArr2->row = row;
         thisArr2->col = col;
         thisArr2->size = size;
+        thisArr2->stride = (col * size + CACHE_LINE - 1) /
+                           CACHE_LINE * CACHE_LINE;
 
-        UArray_T temp;
-        UArray_T *temp1;
-        for (int i = 0; i < row; i++) {
-                temp = UArray_new(col, size);
-                temp1 = UArray_at(thisArr2->spine, i);
-                assert(sizeof(*temp1) == UArray_size(thisArr2->spine));
-                *temp1 = temp;
+        size_t length = (size_t)thisArr2->stride * row;
+        length = (length + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        if (length == 0) {
+                length = HUGE_PAGE;
         }
+        void *block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        block = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (block == MAP_FAILED) {
+                block = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (block == MAP_FAILED) {
+                        free(thisArr2);
+                        RAISE(Bad_Alloc);
+                }
+#ifdef MADV_HUGEPAGE
+                madvise(block, length, MADV_HUGEPAGE);
+#endif
+        }
+        thisArr2->elems = block;
+        thisArr2->mapped = length;
+        thisArr2->is_view = 0;
+
+        /* split the rows into one band per thread; the calling thread
+        zeroes the first band itself */
+        if (nthreads > row) {
+                nthreads = row > 0 ? row : 1;
+        }
+        pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+        struct band *bands = malloc(nthreads * sizeof(struct band));
+        if (threads == NULL || bands == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        for (int i = 0; i < nthreads; i++) {
+                int first = (int)((long)row * i / nthreads);
+                int last = (int)((long)row * (i + 1) / nthreads);
+                bands[i].start = thisArr2->elems +
+                                 (size_t)first * thisArr2->stride;
+                bands[i].length = (size_t)(last - first) * thisArr2->stride;
+        }
+        int started = 1;
+        for (; started < nthreads; started++) {
+                if (pthread_create(&threads[started], NULL, touch_band,
+                                   &bands[started]) != 0) {
+                        break;
+                }
+        }
+        touch_band(&bands[0]);
+        for (int i = started; i < nthreads; i++) {
+                touch_band(&bands[i]);
+        }
+        for (int i = 1; i < started; i++) {
+                pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(bands);
         return thisArr2;
 }
 
+// Does: makes a view of the width * height rectangle of UArray2 whose top
+//       left element is at col, row, sharing its elements
+// Expects: a non-null pointer to a UArray2 and a rectangle inside it.
+//          Expects an output of non-null UArray2 pointer.
+T UArray2_view(T UArray2, int col, int row, int width, int height)
+{
+        assert(UArray2 != NULL);
+        if (col < 0 || row < 0 || width < 0 || height < 0 ||
+            col + width > UArray2->col || row + height > UArray2->row) {
+                RAISE(UArray2_Bounds);
+        }
+        T view = malloc(sizeof(struct UArray2_T));
+        if (view == NULL) {
+                RAISE(Bad_Alloc);
+        }
+        view->col = width;
+        view->row = height;
+        view->size = UArray2->size;
+        view->stride = UArray2->stride;
+        view->elems = UArray2->elems + (size_t)row * UArray2->stride +
+                      (size_t)col * UArray2->size;
+        view->mapped = 0;
+        view->is_view = 1;
+        return view;
+}
+
 // Does: Frees the a given UArray2
 // Expects: a non-null pointer to a UArray2. No Output
 void UArray2_free(T *UArray2)
 {
-  // overall pointer to the entire UArray2 is the spine UArray
- // iterate through the spine
-        for (int i = 0; i < UArray2_height(*UArray2); i++) {
-    // call UArray_free(ith elem of spine)
-                UArray_T *thisArr = UArray_at(((*UArray2)->spine), i);
-                assert(sizeof(*thisArr) == UArray_size((*UArray2)->spine));
-                UArray_free(thisArr);
-                thisArr = NULL;
-        }
-  // cal UArray free on the spine
-        UArray_free(&((*UArray2)->spine));
-  //*UArray2 = NULL;
+        assert(UArray2 != NULL && *UArray2 != NULL);
+        /* a view's elements belong to the array it is a view of */
+        if ((*UArray2)->mapped > 0) {
+                munmap((*UArray2)->elems, (*UArray2)->mapped);
+        } else if (!(*UArray2)->is_view) {
+                free((*UArray2)->elems);
+        }
         free(*UArray2);
+        *UArray2 = NULL;
 }
 // Does: Returns the width of given UArray2
 // Expects: a non-null pointer to a UArray2. Outputs a Int greater than 0
@@ -99,13 +210,149 @@ int UArray2_size(T UArray2)
 //          Outputs a non-null void*
 void *UArray2_at(T UArray2, int col, int row)
 {
-        if (col >= UArray2->col || row >= UArray2->row) {
-                RAISE(Bounds);
+        if (col < 0 || row < 0 || col >= UArray2->col ||
+            row >= UArray2->row) {
+                RAISE(UArray2_Bounds);
+        }
+        return UArray2->elems + (size_t)row * UArray2->stride +
+               (size_t)col * UArray2->size;
+}
+
+// Does: copies a rectangle of src into dst one memmove per row, going
+//       bottom up when the destination lies below the source in the
+//       same block so overlapping rows are read before they are written
+// Expects: non-null UArray2s with the same element size, both rectangles
+//          inside their arrays. No Output
+void UArray2_copy_region(T dst, int dcol, int drow, T src, int scol,
+        int srow, int width, int height)
+{
+        assert(dst != NULL && src != NULL);
+        assert(dst->size == src->size);
+        check_rect(dst, dcol, drow, width, height);
+        check_rect(src, scol, srow, width, height);
+        if (width == 0 || height == 0) {
+                return;
+        }
+        size_t bytes = (size_t)width * src->size;
+        char *to = dst->elems + (size_t)drow * dst->stride +
+                   (size_t)dcol * dst->size;
+        char *from = src->elems + (size_t)srow * src->stride +
+                     (size_t)scol * src->size;
+        if (to > from) {
+                for (int i = height - 1; i >= 0; i--) {
+                        memmove(to + (size_t)i * dst->stride,
+                                from + (size_t)i * src->stride, bytes);
+                }
+        } else {
+                for (int i = 0; i < height; i++) {
+                        memmove(to + (size_t)i * dst->stride,
+                                from + (size_t)i * src->stride, bytes);
+                }
+        }
+}
+
+// Does: sets every element of a rectangle to a copy of *elem, building the
+//       first row and then copying it to the rest
+// Expects: a non-null UArray2, a rectangle inside it, and elem pointing at
+//          UArray2_size bytes. No Output
+void UArray2_fill(T UArray2, int col, int row, int width, int height,
+        const void *elem)
+{
+        assert(UArray2 != NULL && elem != NULL);
+        check_rect(UArray2, col, row, width, height);
+        if (width == 0 || height == 0) {
+                return;
+        }
+        size_t bytes = (size_t)width * UArray2->size;
+        char *first = UArray2->elems + (size_t)row * UArray2->stride +
+                      (size_t)col * UArray2->size;
+
+        const char *pattern = elem;
+        int zero = 1;
+        for (int i = 0; i < UArray2->size; i++) {
+                zero &= pattern[i] == 0;
+        }
+        if (zero) {
+                memset(first, 0, bytes);
+        } else {
+                memcpy(first, elem, UArray2->size);
+                for (size_t done = UArray2->size; done < bytes; ) {
+                        size_t chunk = done < bytes - done ? done :
+                                       bytes - done;
+                        memcpy(first + done, first, chunk);
+                        done += chunk;
+                }
+        }
+        for (int i = 1; i < height; i++) {
+                memcpy(first + (size_t)i * UArray2->stride, first, bytes);
+        }
+}
+
+// Does: exchanges the contents of two rows through a small buffer
+// Expects: a non-null UArray2 and two rows inside it. No Output
+void UArray2_swap_rows(T UArray2, int row1, int row2)
+{
+        assert(UArray2 != NULL);
+        check_rect(UArray2, 0, row1, 0, 1);
+        check_rect(UArray2, 0, row2, 0, 1);
+        if (row1 == row2) {
+                return;
+        }
+        char buffer[256];
+        size_t bytes = (size_t)UArray2->col * UArray2->size;
+        char *a = UArray2->elems + (size_t)row1 * UArray2->stride;
+        char *b = UArray2->elems + (size_t)row2 * UArray2->stride;
+        for (size_t done = 0; done < bytes; done += sizeof(buffer)) {
+                size_t chunk = bytes - done < sizeof(buffer) ?
+                               bytes - done : sizeof(buffer);
+                memcpy(buffer, a + done, chunk);
+                memcpy(a + done, b + done, chunk);
+                memcpy(b + done, buffer, chunk);
+        }
+}
+
+// Does: copies count rows starting at row from so they start at row to.
+//       An array that owns its block holds its rows back to back, so
+//       they move in a single memmove; a view moves a row at a time.
+// Expects: a non-null UArray2 and both ranges of rows inside it. No Output
+void UArray2_move_rows(T UArray2, int from, int to, int count)
+{
+        assert(UArray2 != NULL);
+        check_rect(UArray2, 0, from, UArray2->col, count);
+        check_rect(UArray2, 0, to, UArray2->col, count);
+        if (count == 0 || from == to) {
+                return;
+        }
+        if (!UArray2->is_view) {
+                memmove(UArray2->elems + (size_t)to * UArray2->stride,
+                        UArray2->elems + (size_t)from * UArray2->stride,
+                        (size_t)count * UArray2->stride);
+        } else {
+                UArray2_copy_region(UArray2, 0, to, UArray2, 0, from,
+                                    UArray2->col, count);
         }
-        UArray_T *row_arr = UArray_at((UArray2->spine), row);
-        assert(sizeof(*row_arr) == UArray_size(UArray2->spine));
-        void* result = UArray_at(*row_arr, col);
-        return result;
+}
+
+// Does: changes the shape of UArray2 in place by making a new block of the
+//       new shape (mapped like the old one), copying the overlapping
+//       rectangle into it, and swapping it in
+// Expects: a non-null UArray2 that is not a view, and a non-negative
+//          width and height. No Output
+void UArray2_resize(T UArray2, int col, int row)
+{
+        assert(UArray2 != NULL && col >= 0 && row >= 0);
+        assert(!UArray2->is_view);
+        T resized = UArray2->mapped > 0 ?
+                UArray2_new_large(col, row, UArray2->size, 1) :
+                UArray2_new(col, row, UArray2->size);
+        UArray2_copy_region(resized, 0, 0, UArray2, 0, 0,
+                            col < UArray2->col ? col : UArray2->col,
+                            row < UArray2->row ? row : UArray2->row);
+
+        struct UArray2_T old = *UArray2;
+        *UArray2 = *resized;
+        *resized = old;
+        UArray2_free(&resized);
 }
 
 /*
@@ -124,12 +371,10 @@ void UArray2_map_col_major(T UArray2,
         }
 
         for (int i = 0; i < UArray2->col; i++) {
+                char *thisElem = UArray2->elems + (size_t)i * UArray2->size;
                 for (int j = 0; j < UArray2->row; j++) {
-                        void* thisElem = UArray2_at(UArray2, i, j);
-                        if (thisElem == NULL) {
-                                assert(0);
-                        }
                         apply(i, j, UArray2, thisElem, cl);
+                        thisElem += UArray2->stride;
                 }
         }
 }
@@ -150,12 +395,37 @@ void UArray2_map_row_major(T UArray2,
         }
 
         for (int i = 0; i < UArray2->row; i++) {
+                char *thisElem = UArray2->elems + (size_t)i * UArray2->stride;
                 for (int j = 0; j < UArray2->col; j++) {
-                        void* thisElem = UArray2_at(UArray2, j, i);
-                        if (thisElem == NULL) {
-                                assert(0);
-                        }
                         apply(j, i, UArray2, thisElem, cl);
+                        thisElem += UArray2->size;
                 }
         }
 }
+
+/*
+Description: Thread body for UArray2_new_large that writes zeros over a
+        band of a new block so its pages are first touched by this thread
+Input: a pointer to the band struct
+Output: NULL
+*/
+static void *touch_band(void *cl)
+{
+        struct band *band = cl;
+        memset(band->start, 0, band->length);
+        return NULL;
+}
+
+/*
+Description: Raises UArray2_Bounds unless the width * height rectangle
+        with top left element at col, row lies inside UArray2
+Input: a UArray2_T, the rectangle's col, row, width and height
+Output: none
+*/
+static void check_rect(T UArray2, int col, int row, int width, int height)
+{
+        if (col < 0 || row < 0 || width < 0 || height < 0 ||
+            col + width > UArray2->col || row + height > UArray2->row) {
+                RAISE(UArray2_Bounds);
+        }
+}
@@ -8,6 +8,26 @@ typedef struct T *T;
 //          Expects an output of non-null UArray2 pointer.
 T UArray2_new(int col, int row, int size);
 
+// Does: makes a new UArray2_T like UArray2_new, laid out for very large
+//       arrays: each row starts on a 64 byte cache line, the block is
+//       mapped with huge pages where the system allows it (MAP_HUGETLB,
+//       else transparent huge pages), and nthreads threads each zero a
+//       band of rows so that, under first-touch NUMA placement, a band
+//       lives on the node of the thread that first wrote it.
+// Expects: a positive non-zero width, height, size, and nthreads.
+//          Expects an output of non-null UArray2 pointer.
+T UArray2_new_large(int col, int row, int size, int nthreads);
+
+// Does: makes a view of the width * height rectangle of UArray2 whose top
+//       left element is at col, row. The view shares the elements of
+//       UArray2, so nothing is copied; every UArray2 function (and the
+//       typed accessors) takes it with indices and bounds relative to
+//       the view. Freeing the view frees only the view, and it must not
+//       outlive UArray2.
+// Expects: a non-null pointer to a UArray2 and a rectangle inside it.
+//          Expects an output of non-null UArray2 pointer.
+T UArray2_view(T UArray2, int col, int row, int width, int height);
+
 // Does: Frees the a given UARRAY2
 // Expects: a non-null pointer to a UArray2. No Output
 void UArray2_free(T *UArray2);
@@ -29,6 +49,42 @@ int UArray2_size(T UArray2);
 //          Outputs a non-null void*
 void *UArray2_at(T UArray2, int col, int row);
 
+// Does: copies the width * height rectangle of src whose top left element
+//       is at scol, srow into dst with its top left element at dcol,
+//       drow, one memmove per row. src and dst may be the same array (or
+//       views of it) and the rectangles may overlap.
+// Expects: non-null UArray2s with the same element size, both rectangles
+//          inside their arrays. No Output
+void UArray2_copy_region(T dst, int dcol, int drow, T src, int scol,
+        int srow, int width, int height);
+
+// Does: sets every element of the width * height rectangle whose top left
+//       element is at col, row to a copy of *elem. The first row is
+//       built by doubling memcpys (or one memset when *elem is all zero
+//       bytes) and then copied to the others.
+// Expects: a non-null UArray2, a rectangle inside it, and elem pointing at
+//          UArray2_size bytes. No Output
+void UArray2_fill(T UArray2, int col, int row, int width, int height,
+        const void *elem);
+
+// Does: exchanges the contents of rows row1 and row2
+// Expects: a non-null UArray2 and two rows inside it. No Output
+void UArray2_swap_rows(T UArray2, int row1, int row2);
+
+// Does: copies count rows starting at row from so they start at row to,
+//       as one memmove when the rows are contiguous. The rows may
+//       overlap; rows moved away from keep their old contents.
+// Expects: a non-null UArray2 and both ranges of rows inside it. No Output
+void UArray2_move_rows(T UArray2, int from, int to, int count);
+
+// Does: changes the width and height of UArray2 in place, keeping the
+//       elements that are in both the old and new shape where they were
+//       and zeroing the new ones. An array from UArray2_new_large stays
+//       cache line aligned.
+// Expects: a non-null UArray2 that is not a view, and a non-negative
+//          width and height. No Output
+void UArray2_resize(T UArray2, int col, int row);
+
 void UArray2_map_col_major(T UArray2,
         void apply(int col, int row, T UArray2, void *p1, void *p2), void *cl);
 
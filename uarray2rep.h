@@ -0,0 +1,29 @@
+#ifndef UARRAY2REP
+#define UARRAY2REP
+#include <stddef.h>
+#include <except.h>
+#define T UArray2_T
+
+/*
+The representation of a UArray2_T, shared with the typed accessors in
+uarray2t.h. The elements are stored row after row in one block; each
+row starts stride bytes after the one before it. mapped is the length of
+the block when it came from mmap (UArray2_new_large) and 0 when it came
+from malloc. A view (UArray2_view) points elems into another array's
+block and has is_view set, so freeing it leaves the block alone.
+*/
+struct T {
+        int col;
+        int row;
+        int size;
+        int stride;
+        char *elems;
+        size_t mapped;
+        int is_view;
+};
+
+/* Raised by UArray2_at and the typed accessors for a bad index */
+extern Except_T UArray2_Bounds;
+
+#undef T
+#endif
@@ -0,0 +1,102 @@
+#ifndef UARRAY2T
+#define UARRAY2T
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+#include "uarray2.h"
+#include "uarray2rep.h"
+
+/*
+Typed two dimensional arrays. UARRAY2_TYPED(Name, Type) generates inline
+accessors for a UArray2_T whose elements are of type Type:
+
+        UArray2_T UArray2_Name_new(int col, int row)
+        Type *UArray2_Name_row(UArray2_T arr, int row)
+        Type *UArray2_Name_at(UArray2_T arr, int col, int row)
+
+Because they are inline and know the element type, the compiler can see
+through them, unlike UArray2_at which returns a void * from another
+file. The arrays are ordinary UArray2_Ts, so the rest of the UArray2
+interface works on them too. The accessors assert that the array's
+elements are the size of Type, so one made for another type fails
+rather than being read out of bounds.
+*/
+#define UARRAY2_TYPED(Name, Type) \
+static inline UArray2_T UArray2_##Name##_new(int col, int row) \
+{ \
+        return UArray2_new(col, row, sizeof(Type)); \
+} \
+static inline Type *UArray2_##Name##_row(UArray2_T arr, int row) \
+{ \
+        assert(arr->size == sizeof(Type)); \
+        if ((unsigned)row >= (unsigned)arr->row) { \
+                RAISE(UArray2_Bounds); \
+        } \
+        return (Type *)(arr->elems + (size_t)row * arr->stride); \
+} \
+static inline Type *UArray2_##Name##_at(UArray2_T arr, int col, int row) \
+{ \
+        if ((unsigned)col >= (unsigned)arr->col) { \
+                RAISE(UArray2_Bounds); \
+        } \
+        return UArray2_##Name##_row(arr, row) + col; \
+}
+
+UARRAY2_TYPED(u8, uint8_t)
+UARRAY2_TYPED(i32, int32_t)
+UARRAY2_TYPED(int, int)
+UARRAY2_TYPED(f32, float)
+
+/*
+Traversal macros whose body is expanded in place instead of being
+called through a function pointer. col_var and row_var name int
+variables and elem_var names a Type * to the current element, all in
+scope in the body:
+
+        UARRAY2_FOR_ROW_MAJOR(int, puzzle, col, row, elem) {
+                *elem += 1;
+        }
+
+A break leaves the whole traversal and a continue moves on to the next
+element. The innermost generated loop runs the body once per element
+with the flag uarray2_go cleared, and sets it again only when the body
+finishes, so after a break the flag stops the outer loops too.
+*/
+#define UARRAY2_FOR_ROW_MAJOR(Type, arr, col_var, row_var, elem_var) \
+        for (int uarray2_go = 1, row_var = 0; \
+             uarray2_go && row_var < (arr)->row; row_var++) \
+        for (int col_var = 0; uarray2_go && col_var < (arr)->col; \
+             col_var++) \
+        for (Type *elem_var = (uarray2_go = 0, (Type *)((arr)->elems + \
+                (size_t)row_var * (arr)->stride) + col_var); \
+             elem_var != NULL; elem_var = NULL, uarray2_go = 1)
+
+#define UARRAY2_FOR_COL_MAJOR(Type, arr, col_var, row_var, elem_var) \
+        for (int uarray2_go = 1, col_var = 0; \
+             uarray2_go && col_var < (arr)->col; col_var++) \
+        for (int row_var = 0; uarray2_go && row_var < (arr)->row; \
+             row_var++) \
+        for (Type *elem_var = (uarray2_go = 0, (Type *)((arr)->elems + \
+                (size_t)row_var * (arr)->stride) + col_var); \
+             elem_var != NULL; elem_var = NULL, uarray2_go = 1)
+
+/*
+Replaces every element x of arr with the value of expr, one whole row
+at a time, so the inner loop runs over contiguous elements and can be
+vectorised:
+
+        UARRAY2_TRANSFORM(float, image, x, x * 0.5f + 1.0f);
+*/
+#define UARRAY2_TRANSFORM(Type, arr, x, expr) \
+        for (int uarray2_row = 0; uarray2_row < (arr)->row; \
+             uarray2_row++) { \
+                Type *uarray2_elems = (Type *)((arr)->elems + \
+                        (size_t)uarray2_row * (arr)->stride); \
+                for (int uarray2_col = 0; uarray2_col < (arr)->col; \
+                     uarray2_col++) { \
+                        Type x = uarray2_elems[uarray2_col]; \
+                        uarray2_elems[uarray2_col] = (expr); \
+                } \
+        }
+
+#endif
@@ -0,0 +1,135 @@
+/*
+                unblack.c
+
+        This is the implementation of incremental black edge removal,
+        which redoes only the part of the work an edit could change
+
+        Authors: Kenneth Xue (kxue01)
+                Alyssa Rose (arose10)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <except.h>
+#include <assert.h>
+#include "unblack.h"
+
+/*
+Struct holding a growable list of pixel coordinates, x and y side by
+side, which is both the queue of the search and the record of every
+pixel it has taken out of the image
+*/
+struct pixels {
+        int *xy;
+        int length;
+        int capacity;
+};
+
+static Except_T Bad_Alloc = { "Could not allocate memory" };
+
+static int follow(Bit2_T image, int x, int y, struct pixels *seen);
+static void take(Bit2_T image, int x, int y, struct pixels *seen);
+
+/*
+Description: Follows the component of every black pixel of the changed
+        rectangles. While a component is followed its pixels are set to
+        white, so each one is visited once and later seeds in it are
+        skipped; components that do not reach an edge are put back once
+        every rectangle is done.
+Input: the edited Bit2_T image, an array of changed rectangles and its
+        length
+Output: (int) the number of pixels cleared
+*/
+int Unblack_changed(Bit2_T image, struct Unblack_rect *changed,
+                    int nchanged)
+{
+        assert(image != NULL && (changed != NULL || nchanged == 0));
+        struct pixels seen = { NULL, 0, 0 };
+        int cleared = 0;
+        for (int i = 0; i < nchanged; i++) {
+                int left = changed[i].x < 0 ? 0 : changed[i].x;
+                int top = changed[i].y < 0 ? 0 : changed[i].y;
+                int right = changed[i].x + changed[i].width;
+                int bottom = changed[i].y + changed[i].height;
+                right = right > Bit2_width(image) ? Bit2_width(image) : right;
+                bottom = bottom > Bit2_height(image) ?
+                         Bit2_height(image) : bottom;
+                if (left >= right || top >= bottom) {
+                        continue;
+                }
+                Bit2_T rect = Bit2_view(image, left, top, right - left,
+                                        bottom - top);
+                int x = 0;
+                int y = 0;
+                while (Bit2_next_black(rect, &x, &y)) {
+                        int start = seen.length;
+                        if (follow(image, left + x, top + y, &seen)) {
+                                cleared += (seen.length - start) / 2;
+                                seen.length = start;
+                        }
+                }
+                Bit2_free(&rect);
+        }
+        for (int k = 0; k < seen.length; k += 2) {
+                Bit2_put(image, seen.xy[k], seen.xy[k + 1], 1);
+        }
+        free(seen.xy);
+        return cleared;
+}
+
+/*
+Description: Takes the 4-connected component of the black pixel (x, y)
+        out of the image, appending its pixels to seen
+Input: the Bit2_T image, int x, int y, the list of pixels taken
+Output: 1 if the component touches an edge of the image, 0 otherwise
+*/
+static int follow(Bit2_T image, int x, int y, struct pixels *seen)
+{
+        int width = Bit2_width(image);
+        int height = Bit2_height(image);
+        int edge = 0;
+        int next = seen->length;
+        take(image, x, y, seen);
+        while (next < seen->length) {
+                x = seen->xy[next];
+                y = seen->xy[next + 1];
+                next += 2;
+                if (x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+                        edge = 1;
+                }
+                if (x > 0 && Bit2_get(image, x - 1, y)) {
+                        take(image, x - 1, y, seen);
+                }
+                if (x < width - 1 && Bit2_get(image, x + 1, y)) {
+                        take(image, x + 1, y, seen);
+                }
+                if (y > 0 && Bit2_get(image, x, y - 1)) {
+                        take(image, x, y - 1, seen);
+                }
+                if (y < height - 1 && Bit2_get(image, x, y + 1)) {
+                        take(image, x, y + 1, seen);
+                }
+        }
+        return edge;
+}
+
+/*
+Description: Sets the pixel (x, y) to white and appends it to seen,
+        doubling the list when it is full
+Input: the Bit2_T image, int x, int y, the list of pixels taken
+Output: none
+*/
+static void take(Bit2_T image, int x, int y, struct pixels *seen)
+{
+        if (seen->length + 2 > seen->capacity) {
+                int capacity = seen->capacity == 0 ? 64 : 2 * seen->capacity;
+                int *xy = realloc(seen->xy, capacity * sizeof(int));
+                if (xy == NULL) {
+                        RAISE(Bad_Alloc);
+                }
+                seen->xy = xy;
+                seen->capacity = capacity;
+        }
+        Bit2_put(image, x, y, 0);
+        seen->xy[seen->length++] = x;
+        seen->xy[seen->length++] = y;
+}
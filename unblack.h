@@ -0,0 +1,30 @@
+#ifndef UNBLACK
+#define UNBLACK
+#include "bit2.h"
+
+/*
+Struct holding a rectangle of an image that was edited: its top left
+corner and its size in pixels
+*/
+struct Unblack_rect {
+        int x, y;
+        int width, height;
+};
+
+/*
+Description: Removes the black edges again from an image whose black
+        edges were already removed and which has since been edited in
+        the given rectangles. A component touching an edge now must hold
+        an edited pixel, so only the components of the black pixels in
+        the rectangles are followed: those reaching an edge are cleared
+        and the rest are left as they were. The work done is
+        proportional to the size of those components, not the image.
+        Parts of rectangles outside the image are ignored.
+Input: the edited Bit2_T image, an array of changed rectangles and its
+        length
+Output: (int) the number of pixels cleared
+*/
+int Unblack_changed(Bit2_T image, struct Unblack_rect *changed,
+                    int nchanged);
+
+#endif
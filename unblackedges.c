@@ -3,36 +3,128 @@
 
         This program removes black edges from a
         PBM (plain bit map) file (PNM with magic number
-        1) using the Bit2 data type
+        1) using the Bit2 data type. Grayscale and color
+        files are thresholded to black and white as they
+        are read.
 
         Authors: Kenneth Xue (kxue01)
                 Alyssa Rose (arose10)
 
 */
+#define _POSIX_C_SOURCE 200809L
 #include "bit2.h"
+#include "bit2queue.h"
+#include "label.h"
+#include "unblack.h"
+#include "trace.h"
+#include "uarray2t.h"
 #include <pnmrdr.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stack.h>
+#include <bit.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <except.h>
 
 
+/* How much darker than its block's mean a pixel must be to turn black
+when thresholding adaptively */
+#define ADAPTIVE_PERCENT 15
+
+/* The largest block size --adaptive takes */
+#define ADAPTIVE_MAX 4096
+
+/* How the automatic engine choice reads the image statistics: how many
+rows are sampled for runs, the mean run length in pixels below which a
+page counts as noisy, and the percentage of black pixels at or above
+which a page counts as heavy */
+#define AUTO_SAMPLE_ROWS 32
+#define AUTO_NOISY_RUN 4
+#define AUTO_HEAVY_PERCENT 25
+
 /* Error messages */
-static Except_T Args = {"More Than One Argument"};
+static Except_T Args = {"Invalid Argument"};
 static Except_T No_PBM = {"PBM Not Provided"};
 static Except_T Malloc_Fail = {"Memory Allocation Failed"};
 static Except_T Bad_Pointer = {"File Pointer NULL"};
 
+/* Ways of removing the black edges of an image */
+enum engine {
+        ENGINE_BFS,     /* pixel by pixel search from each edge pixel */
+        ENGINE_BLOCK,   /* search that clears whole full pyramid blocks */
+        ENGINE_LABEL,   /* component labeling, then erase edge components */
+        ENGINE_CHANGED, /* follow only the components of edited rectangles */
+        ENGINE_SKIP,    /* nothing to do, as no edge pixel is black */
+        ENGINE_AUTO     /* pick one of the above from image statistics */
+};
+
+static const char *engine_names[] = {
+        "bfs", "block", "label", "changed", "skip", "auto"
+};
+
+/*
+Struct holding the cheap statistics the engine is chosen from
+*/
+struct image_stats {
+        int perimeter;          /* pixels on the edges of the image */
+        int perimeter_black;    /* black pixels among them */
+        long pixels;            /* pixels in the whole image */
+        int black;              /* black pixels among them */
+        int sampled;            /* pixels in the rows sampled for runs */
+        int sampled_black;      /* black pixels among them */
+        int runs;               /* runs of black pixels in those rows */
+};
+
+/*
+Struct holding the command line options
+*/
+struct options {
+        int depth;
+        enum engine engine;
+        int rotate;
+        int crop;       /* padding kept around the content, -1 for none */
+        double threshold;       /* fraction of full brightness below
+                                which a gray or color pixel is black */
+        int adaptive;   /* block size for adaptive thresholds, 0 for none */
+        int speck;      /* components smaller than this many pixels are
+                        erased along with the edges, 0 for none */
+        int native;     /* write Bit2 native files instead of PBM */
+        struct Unblack_rect *changed;   /* rectangles edited since the
+                                        input was cleaned, NULL for none */
+        int nchanged;
+        int stats;      /* report each image's statistics and engine */
+};
+
 /* Functions */
-Bit2_T pbmread(FILE *inputfp);
+Bit2_T pbmread(FILE *inputfp, struct options *opts, Bit2_T spare);
+Bit2_T blank_image(int width, int height, Bit2_T spare);
+void track_counts(Bit2_T image, struct options *opts);
+unsigned gray_value(Pnmrdr_T pgm);
+void threshold_global(Pnmrdr_T pgm, Bit2_T image, double threshold);
+void threshold_adaptive(Pnmrdr_T pgm, Bit2_T image, int block);
+FILE *open_input(char *filename);
+int more_images(FILE *inputfp);
 void pbmwrite(FILE *outputfp, Bit2_T bitarr);
+void write_image(FILE *outputfp, Bit2_T bitarr, struct options *opts);
+void run_serial(char **files, int nfiles, struct options *opts);
+void run_pipeline(char **files, int nfiles, struct options *opts);
+void *reader_thread(void *cl);
+void *writer_thread(void *cl);
+void clean_image(Bit2_T *image, struct options *opts);
+struct image_stats sample_stats(Bit2_T image);
+enum engine choose_engine(struct image_stats *stats);
 void traverse_edges(Bit2_T *image);
 void BFS(Bit2_T *bit, int x, int y);
+void traverse_edges_blocks(Bit2_T *image);
+void BFS_blocks(Bit2_T *bit, int x, int y);
+int edge_or_speck(int label, struct Label_stats *stats, void *cl);
 bool valid_edge(Bit2_T bit, int x, int y);
 struct index *make_coord(int x, int y);
 void visit_neighbor(struct index *new_ind, Stack_T *Primary, Bit2_T bit);
+bool clear_full_block(struct index *ind, Stack_T *Primary, Bit2_T bit);
 
 /*
 Struct to hold coordinates of a black
@@ -42,94 +134,665 @@ struct index {
         int x, y;
 };
 
+/*
+Struct shared by the threads of the pipeline: the files still to be
+read and the queues that carry images from the reader to the fill
+and from the fill to the writer
+*/
+struct pipeline {
+        char **files;
+        int nfiles;
+        struct options *opts;
+        Bit2queue_T to_fill;
+        Bit2queue_T to_write;
+};
+
+/*
+Struct holding what an adaptive threshold compares each pixel of one
+block with: a pixel is black when its value times area is below limit
+*/
+struct block_limit {
+        long long limit, area;
+};
+
 
 int main(int argc, char *argv[])
 {
-        if (argc > 2) {
-                RAISE(Args);
-        }
-        if (argc == 2) {
-                FILE *fp = fopen(argv[1], "r");
-                if (fp == NULL) {
-                        RAISE(No_PBM);
+        struct options opts = { 0, ENGINE_AUTO, 0, -1, 0.5, 0, 0, 0, NULL,
+                                0, 0 };
+        int first = 1;
+        while (first < argc && strncmp(argv[first], "--", 2) == 0) {
+                if (strcmp(argv[first], "--pipeline") == 0) {
+                        opts.depth = 2;
+                } else if (strncmp(argv[first], "--pipeline=", 11) == 0) {
+                        opts.depth = atoi(argv[first] + 11);
+                        if (opts.depth < 1) {
+                                RAISE(Args);
+                        }
+                } else if (strcmp(argv[first], "--engine=bfs") == 0) {
+                        opts.engine = ENGINE_BFS;
+                } else if (strcmp(argv[first], "--engine=block") == 0) {
+                        opts.engine = ENGINE_BLOCK;
+                } else if (strcmp(argv[first], "--engine=label") == 0) {
+                        opts.engine = ENGINE_LABEL;
+                } else if (strcmp(argv[first], "--engine=auto") == 0) {
+                        opts.engine = ENGINE_AUTO;
+                } else if (strncmp(argv[first], "--trace=", 8) == 0) {
+                        if (argv[first][8] == '\0') {
+                                RAISE(Args);
+                        }
+                        Trace_open(argv[first] + 8);
+                } else if (strcmp(argv[first], "--stats") == 0) {
+                        opts.stats = 1;
+                } else if (strcmp(argv[first], "--native") == 0) {
+                        opts.native = 1;
+                } else if (strcmp(argv[first], "--crop") == 0) {
+                        opts.crop = 0;
+                } else if (strncmp(argv[first], "--crop=", 7) == 0) {
+                        opts.crop = atoi(argv[first] + 7);
+                        if (opts.crop < 0) {
+                                RAISE(Args);
+                        }
+                } else if (strncmp(argv[first], "--threshold=", 12) == 0) {
+                        opts.threshold = atof(argv[first] + 12);
+                        if (opts.threshold <= 0 || opts.threshold > 1) {
+                                RAISE(Args);
+                        }
+                } else if (strncmp(argv[first], "--adaptive=", 11) == 0) {
+                        opts.adaptive = atoi(argv[first] + 11);
+                        if (opts.adaptive < 1 ||
+                            opts.adaptive > ADAPTIVE_MAX) {
+                                RAISE(Args);
+                        }
+                } else if (strncmp(argv[first], "--speck=", 8) == 0) {
+                        opts.speck = atoi(argv[first] + 8);
+                        if (opts.speck < 1) {
+                                RAISE(Args);
+                        }
+                } else if (strncmp(argv[first], "--changed=", 10) == 0) {
+                        if (opts.changed == NULL) {
+                                opts.changed = malloc(argc *
+                                        sizeof(struct Unblack_rect));
+                                if (opts.changed == NULL) {
+                                        RAISE(Malloc_Fail);
+                                }
+                        }
+                        struct Unblack_rect *rect =
+                                &opts.changed[opts.nchanged++];
+                        if (sscanf(argv[first] + 10, "%d,%d,%d,%d",
+                                   &rect->x, &rect->y, &rect->width,
+                                   &rect->height) != 4 ||
+                            rect->width < 0 || rect->height < 0) {
+                                RAISE(Args);
+                        }
+                } else if (strncmp(argv[first], "--rotate=", 9) == 0) {
+                        opts.rotate = atoi(argv[first] + 9);
+                        if (opts.rotate % 90 != 0) {
+                                RAISE(Args);
+                        }
                 } else {
-                        Bit2_T pbm = pbmread(fp);
-                        fclose(fp);
-                        traverse_edges(&pbm);
-                        pbmwrite(stdout, pbm);
-                        Bit2_free(&pbm);
+                        RAISE(Args);
                 }
+                first++;
         }
-        if (argc == 1) {
-                FILE *fp = stdin;
-                if (fp == NULL) {
-                        RAISE(No_PBM);
-                } else {
-                        Bit2_T pbm = pbmread(fp);
-                        fclose(fp);
-                        traverse_edges(&pbm);
-                        pbmwrite(stdout, pbm);
-                        Bit2_free(&pbm);
-                }
+        /* specks may be anywhere, so they cannot be found incrementally */
+        if (opts.nchanged > 0 && opts.speck > 0) {
+                RAISE(Args);
         }
+
+        /* With no file names the image is read from stdin */
+        char *no_files[] = { NULL };
+        char **files = no_files;
+        int nfiles = 1;
+        if (first < argc) {
+                files = argv + first;
+                nfiles = argc - first;
+        }
+
+        if (opts.depth > 0) {
+                run_pipeline(files, nfiles, &opts);
+        } else {
+                run_serial(files, nfiles, &opts);
+        }
+        free(opts.changed);
         exit(0);
 }
 
+/*
+Description: Removes the black edges from each image in turn, reading,
+        filling and writing one image before starting the next
+Input: an array of file names (NULL meaning stdin), its length and
+        the command line options
+Output: none
+*/
+void run_serial(char **files, int nfiles, struct options *opts)
+{
+        /* The last image written, kept so the next image of the same
+        size can be read into it instead of a new map */
+        Bit2_T spare = NULL;
+        int image = 0;
+        Trace_thread_name("main");
+        for (int i = 0; i < nfiles; i++) {
+                FILE *fp = open_input(files[i]);
+                do {
+                        image++;
+                        Trace_begin("read", image);
+                        Bit2_T pbm = pbmread(fp, opts, spare);
+                        Trace_end("read", image);
+                        Trace_begin("fill", image);
+                        clean_image(&pbm, opts);
+                        Trace_end("fill", image);
+                        Trace_begin("write", image);
+                        write_image(stdout, pbm, opts);
+                        Trace_end("write", image);
+                        spare = pbm;
+                } while (more_images(fp));
+                fclose(fp);
+        }
+        if (spare != NULL) {
+                Bit2_free(&spare);
+        }
+}
+
+/*
+Description: Removes the black edges from each image using a reader
+        thread, the calling thread and a writer thread connected by
+        bounded queues, so that reading image N+1, filling image N and
+        writing image N-1 all happen at the same time
+Input: an array of file names (NULL meaning stdin), its length and
+        the command line options (whose depth is the number of images
+        each queue may buffer)
+Output: none
+*/
+void run_pipeline(char **files, int nfiles, struct options *opts)
+{
+        struct pipeline pipe;
+        pipe.files = files;
+        pipe.nfiles = nfiles;
+        pipe.opts = opts;
+        pipe.to_fill = Bit2queue_new(opts->depth);
+        pipe.to_write = Bit2queue_new(opts->depth);
+
+        pthread_t reader, writer;
+        if (pthread_create(&reader, NULL, reader_thread, &pipe) != 0 ||
+            pthread_create(&writer, NULL, writer_thread, &pipe) != 0) {
+                RAISE(Malloc_Fail);
+        }
+
+        Bit2_T pbm;
+        int image = 0;
+        Trace_thread_name("fill");
+        while ((pbm = Bit2queue_get(pipe.to_fill)) != NULL) {
+                image++;
+                Trace_begin("fill", image);
+                clean_image(&pbm, opts);
+                Trace_end("fill", image);
+                Bit2queue_put(pipe.to_write, pbm);
+        }
+        Bit2queue_close(pipe.to_write);
+
+        pthread_join(reader, NULL);
+        pthread_join(writer, NULL);
+        Bit2queue_free(&pipe.to_fill);
+        Bit2queue_free(&pipe.to_write);
+}
+
+/*
+Description: Thread body that reads every image of every file of the
+        pipeline and hands it to the fill stage
+Input: a pointer to the shared pipeline struct
+Output: NULL
+*/
+void *reader_thread(void *cl)
+{
+        struct pipeline *pipe = cl;
+        int image = 0;
+        Trace_thread_name("reader");
+        for (int i = 0; i < pipe->nfiles; i++) {
+                FILE *fp = open_input(pipe->files[i]);
+                do {
+                        image++;
+                        Trace_begin("read", image);
+                        Bit2_T pbm = pbmread(fp, pipe->opts, NULL);
+                        Trace_end("read", image);
+                        Bit2queue_put(pipe->to_fill, pbm);
+                } while (more_images(fp));
+                fclose(fp);
+        }
+        Bit2queue_close(pipe->to_fill);
+        return NULL;
+}
+
+/*
+Description: Thread body that writes every filled image of the
+        pipeline to stdout in order and frees it
+Input: a pointer to the shared pipeline struct
+Output: NULL
+*/
+void *writer_thread(void *cl)
+{
+        struct pipeline *pipe = cl;
+        Bit2_T pbm;
+        int image = 0;
+        Trace_thread_name("writer");
+        while ((pbm = Bit2queue_get(pipe->to_write)) != NULL) {
+                image++;
+                Trace_begin("write", image);
+                write_image(stdout, pbm, pipe->opts);
+                Trace_end("write", image);
+                Bit2_free(&pbm);
+        }
+        fflush(stdout);
+        return NULL;
+}
+
+/*
+Description: Opens the named file, or gives stdin when there is no name
+Input: a file name, or NULL for stdin
+Output: the file pointer to read the images from
+*/
+FILE *open_input(char *filename)
+{
+        FILE *fp = stdin;
+        if (filename != NULL) {
+                fp = fopen(filename, "r");
+        }
+        if (fp == NULL) {
+                RAISE(No_PBM);
+        }
+        return fp;
+}
+
+/*
+Description: Skips the whitespace after an image and reports whether
+        another image follows it, as netpbm streams may hold several
+        images one after another
+Input: file pointer just past the end of an image
+Output: 1 if more of the stream is left, 0 at end of file
+*/
+int more_images(FILE *inputfp)
+{
+        int c;
+        do {
+                c = getc(inputfp);
+        } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        if (c == EOF) {
+                return 0;
+        }
+        ungetc(c, inputfp);
+        return 1;
+}
+
+/*
+Description: Gives an all white map of the given size, clearing and
+        reusing spare when it already has that size and freeing it
+        otherwise. A new map has every row on its blank row
+        (Bit2_new_shared), so it holds one row of storage until rows
+        are read into it.
+Input: the width and height of the image, a map to reuse or NULL
+Output: Bit2_T map
+*/
+Bit2_T blank_image(int width, int height, Bit2_T spare)
+{
+        if (spare != NULL && Bit2_width(spare) == width &&
+            Bit2_height(spare) == height && !Bit2_is_view(spare)) {
+                Bit2_pyramid_free(spare);
+                Bit2_clear_rect(spare, 0, 0, width, height);
+                return spare;
+        }
+        if (spare != NULL) {
+                Bit2_free(&spare);
+        }
+        return Bit2_new_shared(width, height);
+}
+
+/*
+Description: Turns on the block counts of image when they will be read,
+        which is when the engine is chosen from the image's statistics
+        or the statistics are reported. Otherwise every change to the
+        image would pay for keeping counts nobody looks at.
+Input: the Bit2_T map just made for an image, the command line options
+Output: none
+*/
+void track_counts(Bit2_T image, struct options *opts)
+{
+        if (opts->engine == ENGINE_AUTO || opts->stats) {
+                Bit2_track_counts(image);
+        }
+}
+
 /*
 Description: reads pixels from a PBM file pointed
-        to by inputfp and stores into a Bit2_T map
-Input: file pointer (either file or stdin)
+        to by inputfp and stores into a Bit2_T map. Grayscale (PGM)
+        and color (PPM) files are thresholded as they are read, each
+        pixel going into the map as black or white. Each row is filled
+        into one scratch Bit_T and put into the map with Bit2_put_row,
+        so a row that is blank or repeats the row before it shares that
+        row's storage and is never allocated, and long runs of equal
+        rows cost one row of memory. Bit2 native files (magic "BIT2") are loaded with
+        Bit2_load. Only one image is read, leaving inputfp at the start
+        of the next one.
+Input: file pointer (either file or stdin), the command line options,
+        a map from an earlier image to reuse (or NULL), which is owned
+        by pbmread from then on
 Output: Bit2_T map
 */
-Bit2_T pbmread(FILE *inputfp)
+Bit2_T pbmread(FILE *inputfp, struct options *opts, Bit2_T spare)
 {
+        int magic = getc(inputfp);
+        ungetc(magic, inputfp);
+        if (magic == 'B') {
+                if (spare != NULL) {
+                        Bit2_free(&spare);
+                }
+                Bit2_T image = Bit2_load(inputfp);
+                track_counts(image, opts);
+                return image;
+        }
         Pnmrdr_T pgm = Pnmrdr_new(inputfp);
         Pnmrdr_mapdata map_data = Pnmrdr_data(pgm);
         int width = map_data.width;
         int height = map_data.height;
         if ((width == 0) || (height == 0) ||
-        map_data.type != 1) {
+        map_data.type < 1 || map_data.type > 3) {
                 Pnmrdr_free(&pgm);
                 fclose(inputfp);
+                if (spare != NULL) {
+                        Bit2_free(&spare);
+                }
                 RAISE(No_PBM);
         }
-        Bit2_T image = Bit2_new(width, height);
+        Bit2_T image = blank_image(width, height, spare);
+        track_counts(image, opts);
+        if (map_data.type != 1) {
+                if (opts->adaptive > 0) {
+                        threshold_adaptive(pgm, image, opts->adaptive);
+                } else {
+                        threshold_global(pgm, image, opts->threshold);
+                }
+                Pnmrdr_free(&pgm);
+                return image;
+        }
         int this_pix;
+        Bit_T row = Bit_new(width);
         for (int i = 0; i < height; i++) {
                 for (int j = 0; j < width; j++) {
                         this_pix = Pnmrdr_get(pgm);
-                        Bit2_put(image, j, i, this_pix);
+                        Bit_put(row, j, this_pix);
                 }
+                Bit2_put_row(image, i, row);
         }
+        Bit_free(&row);
         Pnmrdr_free(&pgm);
         return image;
 }
 
 /*
-Description: Loops through the edge pixels of the image and calls
-        the BFS function if they are black.
-Input: A pointer to a Bit2_T map
+Description: reads the next pixel of a grayscale or color image, giving
+        the brightness of a color pixel as its luma
+Input: the Pnmrdr_T reader
+Output: the brightness, from 0 to the image's denominator
+*/
+unsigned gray_value(Pnmrdr_T pgm)
+{
+        if (Pnmrdr_data(pgm).type == 2) {
+                return Pnmrdr_get(pgm);
+        }
+        unsigned long red = Pnmrdr_get(pgm);
+        unsigned long green = Pnmrdr_get(pgm);
+        unsigned long blue = Pnmrdr_get(pgm);
+        return (299 * red + 587 * green + 114 * blue) / 1000;
+}
+
+/*
+Description: reads a grayscale or color image into image, making every
+        pixel darker than the given fraction of full brightness black
+Input: the Pnmrdr_T reader, the Bit2_T map to fill, the fraction
+Output: none
+*/
+void threshold_global(Pnmrdr_T pgm, Bit2_T image, double threshold)
+{
+        double limit = threshold * Pnmrdr_data(pgm).denominator;
+        Bit_T row = Bit_new(Bit2_width(image));
+        for (int i = 0; i < Bit2_height(image); i++) {
+                for (int j = 0; j < Bit2_width(image); j++) {
+                        Bit_put(row, j, gray_value(pgm) < limit);
+                }
+                Bit2_put_row(image, i, row);
+        }
+        Bit_free(&row);
+}
+
+/*
+Description: reads a grayscale or color image into image a band of
+        block rows at a time, making every pixel black that is more
+        than ADAPTIVE_PERCENT percent darker than the mean of its
+        block * block square. The band holds no more rows than the
+        image has. Once the limits of a band's blocks are known each of
+        its rows is filled into one scratch Bit_T and put into the map.
+Input: the Pnmrdr_T reader, the Bit2_T map to fill, the block size
+Output: none
+*/
+void threshold_adaptive(Pnmrdr_T pgm, Bit2_T image, int block)
+{
+        int width = Bit2_width(image);
+        int height = Bit2_height(image);
+        UArray2_T band = UArray2_i32_new(width, block < height ? block :
+                                                height);
+        struct block_limit *limits = malloc(((width + block - 1) / block) *
+                                            sizeof(*limits));
+        Bit_T row = Bit_new(width);
+        if (limits == NULL) {
+                RAISE(Malloc_Fail);
+        }
+        for (int top = 0; top < height; top += block) {
+                int rows = height - top < block ? height - top : block;
+                for (int i = 0; i < rows; i++) {
+                        int32_t *values = UArray2_i32_row(band, i);
+                        for (int j = 0; j < width; j++) {
+                                values[j] = gray_value(pgm);
+                        }
+                }
+                for (int left = 0; left < width; left += block) {
+                        int cols = width - left < block ? width - left :
+                                   block;
+                        long long sum = 0;
+                        for (int i = 0; i < rows; i++) {
+                                int32_t *values = UArray2_i32_row(band, i);
+                                for (int j = left; j < left + cols; j++) {
+                                        sum += values[j];
+                                }
+                        }
+                        limits[left / block].limit =
+                                sum * (100 - ADAPTIVE_PERCENT);
+                        limits[left / block].area =
+                                (long long)rows * cols * 100;
+                }
+                for (int i = 0; i < rows; i++) {
+                        int32_t *values = UArray2_i32_row(band, i);
+                        for (int j = 0; j < width; j++) {
+                                struct block_limit *b = &limits[j / block];
+                                Bit_put(row, j, values[j] * b->area <
+                                                b->limit);
+                        }
+                        Bit2_put_row(image, top + i, row);
+                }
+        }
+        Bit_free(&row);
+        free(limits);
+        UArray2_free(&band);
+}
+
+/*
+Description: Removes the black edges of the image with the engine
+        chosen on the command line, then rotates it if asked to. When
+        specks are removed too, the labeler is used whatever the engine,
+        since one labeling finds both the edge components and the
+        areas of all the others. When edited rectangles were given, the
+        input is taken to be an already cleaned image and only the
+        components in those rectangles are looked at. With --stats the
+        statistics of the image and the engine used go to stderr.
+Input: A pointer to a Bit2_T map, the command line options
 Output: None
 */
-void traverse_edges(Bit2_T *image)
+void clean_image(Bit2_T *image, struct options *opts)
 {
-        for (int y = 0; y < Bit2_height(*image); y++) {
-            if (Bit2_get(*image, 0, y)) {
-                BFS(image, 0, y);
-            }
+        static int number = 0;
+        Label_T labels;
+        struct image_stats stats = { 0, 0, 0, 0, 0, 0, 0 };
+        if (opts->engine == ENGINE_AUTO || opts->stats) {
+                stats = sample_stats(*image);
+        }
+        enum engine engine = opts->engine == ENGINE_AUTO ?
+                             choose_engine(&stats) : opts->engine;
+        if (opts->speck > 0) {
+                engine = ENGINE_LABEL;
+        }
+        if (opts->nchanged > 0) {
+                engine = ENGINE_CHANGED;
+        }
+        if (opts->stats) {
+                fprintf(stderr, "image %d: %dx%d, edges %.1f%% black, "
+                        "ink %.1f%%, mean run %.1f pixels, engine %s\n",
+                        ++number, Bit2_width(*image), Bit2_height(*image),
+                        100.0 * stats.perimeter_black /
+                        (stats.perimeter > 0 ? stats.perimeter : 1),
+                        100.0 * stats.black /
+                        (stats.pixels > 0 ? stats.pixels : 1),
+                        (double)stats.sampled_black /
+                        (stats.runs > 0 ? stats.runs : 1),
+                        engine_names[engine]);
+        }
+        switch (engine) {
+        case ENGINE_SKIP:
+                break;
+        case ENGINE_CHANGED:
+                Unblack_changed(*image, opts->changed, opts->nchanged);
+                break;
+        case ENGINE_BLOCK:
+                Bit2_pyramid_build(*image);
+                traverse_edges_blocks(image);
+                break;
+        case ENGINE_LABEL:
+                labels = Label_new(*image, 4);
+                Label_erase(labels, *image, edge_or_speck, &opts->speck);
+                Label_free(&labels);
+                break;
+        default:
+                traverse_edges(image);
+                break;
+        }
 
-            if (Bit2_get(*image, Bit2_width(*image) - 1, y)) {
-                BFS(image, Bit2_width(*image) - 1, y);
-            }
+        if (opts->rotate % 360 != 0) {
+                Bit2_T rotated = Bit2_rotate(*image, opts->rotate);
+                Bit2_free(image);
+                *image = rotated;
         }
-        for (int x = 0; x < Bit2_width(*image); x++) {
-            if (Bit2_get(*image, x, 0)) {
-                BFS(image, x, 0);
-            }
+}
 
-            if (Bit2_get(*image, x, Bit2_height(*image) - 1)) {
-                BFS(image, x, Bit2_height(*image) - 1);
-            }
+/*
+Description: Gathers the statistics the engine is chosen from, each in
+        time well under that of removing the edges: the black pixels on
+        the edges (one pixel wide views, so the corners count twice),
+        the black pixels in the image (from its block counts, which
+        pbmread turns on whenever the statistics are needed) and the
+        runs of black pixels in up to AUTO_SAMPLE_ROWS evenly spaced
+        rows
+Input: A Bit2_T map
+Output: the statistics
+*/
+struct image_stats sample_stats(Bit2_T image)
+{
+        struct image_stats stats = { 0, 0, 0, 0, 0, 0, 0 };
+        int width = Bit2_width(image);
+        int height = Bit2_height(image);
+        if (width == 0 || height == 0) {
+                return stats;
+        }
+        int left[4] = { 0, width - 1, 0, 0 };
+        int top[4] = { 0, 0, 0, height - 1 };
+        for (int side = 0; side < 4; side++) {
+                Bit2_T edge = side < 2 ?
+                        Bit2_view(image, left[side], 0, 1, height) :
+                        Bit2_view(image, 0, top[side], width, 1);
+                stats.perimeter += side < 2 ? height : width;
+                stats.perimeter_black += Bit2_count(edge);
+                Bit2_free(&edge);
+        }
+        stats.pixels = (long)width * height;
+        stats.black = Bit2_count(image);
+
+        int rows = height < AUTO_SAMPLE_ROWS ? height : AUTO_SAMPLE_ROWS;
+        for (int i = 0; i < rows; i++) {
+                int y = (int)((long)height * i / rows + height / rows / 2);
+                stats.sampled += width;
+                if (Bit2_region_empty(image, 0, y, width, 1)) {
+                        continue;
+                }
+                int last = 0;
+                for (int x = 0; x < width; x++) {
+                        int bit = Bit2_get(image, x, y);
+                        stats.sampled_black += bit;
+                        stats.runs += bit && !last;
+                        last = bit;
+                }
+        }
+        return stats;
+}
+
+/*
+Description: Picks the engine likely to be fastest for an image from its
+        statistics. An image with no black edge pixel has no black edges,
+        so nothing is done. Noisy pages, whose black pixels come in short
+        runs, go to the run-based labeler, whose work grows with the
+        runs rather than with the pixels and the branching of a search
+        through a maze. Heavy pages, often thick solid frames, go to the
+        block engine, which clears whole full blocks at once. The rest
+        get the pixel search, which only looks at what touches an edge.
+Input: the image statistics
+Output: the engine to use
+*/
+enum engine choose_engine(struct image_stats *stats)
+{
+        if (stats->perimeter_black == 0) {
+                return ENGINE_SKIP;
+        }
+        if (stats->runs > 0 &&
+            stats->sampled_black < AUTO_NOISY_RUN * stats->runs) {
+                return ENGINE_LABEL;
+        }
+        if (100.0 * stats->black >= (double)AUTO_HEAVY_PERCENT *
+            stats->pixels) {
+                return ENGINE_BLOCK;
+        }
+        return ENGINE_BFS;
+}
+
+/*
+Description: Looks at each edge of the image through a one pixel wide
+        view and calls the BFS function on every black pixel found.
+        When the image has block counts, Bit2_next_black uses them to
+        jump from one black edge pixel straight to the next.
+Input: A pointer to a Bit2_T map
+Output: None
+*/
+void traverse_edges(Bit2_T *image)
+{
+        int width = Bit2_width(*image);
+        int height = Bit2_height(*image);
+        int left[4] = { 0, width - 1, 0, 0 };
+        int top[4] = { 0, 0, 0, height - 1 };
+        for (int side = 0; side < 4; side++) {
+                Bit2_T edge = side < 2 ?
+                        Bit2_view(*image, left[side], 0, 1, height) :
+                        Bit2_view(*image, 0, top[side], width, 1);
+                int x = 0;
+                int y = 0;
+                while (Bit2_next_black(edge, &x, &y)) {
+                        BFS(image, left[side] + x, top[side] + y);
+                        x++;
+                }
+                Bit2_free(&edge);
         }
 }
 
@@ -171,9 +834,192 @@ void BFS(Bit2_T *bit, int x, int y)
         }
 }
 
+/*
+Description: Select function for Label_erase that picks the components
+        touching any edge of the image, which are the black edges, and
+        the specks, the components with fewer pixels than the given
+        minimum area
+Input: the component's label and statistics, a pointer to the minimum
+        area as an int (0 to erase only the edges)
+Output: nonzero if the component is to be erased
+*/
+int edge_or_speck(int label, struct Label_stats *stats, void *cl)
+{
+        (void) label;
+        return stats->edges != 0 || stats->area < *(int *) cl;
+}
+
+/*
+Description: Like traverse_edges, but uses the occupancy pyramid of the
+        image to step over edge blocks that are blank and calls
+        BFS_blocks on the black edge pixels
+Input: A pointer to a Bit2_T map with a built pyramid
+Output: None
+*/
+void traverse_edges_blocks(Bit2_T *image)
+{
+        int width = Bit2_width(*image);
+        int height = Bit2_height(*image);
+        for (int y = 0; y < height; y++) {
+                if (y % BIT2_BLOCK0 == 0 &&
+                    !Bit2_block_any(*image, 0, 0, y / BIT2_BLOCK0) &&
+                    !Bit2_block_any(*image, 0, (width - 1) / BIT2_BLOCK0,
+                                    y / BIT2_BLOCK0)) {
+                        y += BIT2_BLOCK0 - 1;
+                        continue;
+                }
+                if (Bit2_get(*image, 0, y)) {
+                        BFS_blocks(image, 0, y);
+                }
+                if (Bit2_get(*image, width - 1, y)) {
+                        BFS_blocks(image, width - 1, y);
+                }
+        }
+        for (int x = 0; x < width; x++) {
+                if (x % BIT2_BLOCK0 == 0 &&
+                    !Bit2_block_any(*image, 0, x / BIT2_BLOCK0, 0) &&
+                    !Bit2_block_any(*image, 0, x / BIT2_BLOCK0,
+                                    (height - 1) / BIT2_BLOCK0)) {
+                        x += BIT2_BLOCK0 - 1;
+                        continue;
+                }
+                if (Bit2_get(*image, x, 0)) {
+                        BFS_blocks(image, x, 0);
+                }
+                if (Bit2_get(*image, x, height - 1)) {
+                        BFS_blocks(image, x, height - 1);
+                }
+        }
+}
+
+/*
+Description: The same search as BFS, except that when it reaches a
+        pixel inside a block the pyramid marks as full it clears the
+        whole block at once and continues from the pixels around it.
+        A full block is one connected piece, so it is either untouched
+        or already cleared when the search reaches it.
+Input: A pointer to a Bit2_T map with a built pyramid, integers x and y
+Output: none
+*/
+void BFS_blocks(Bit2_T *bit, int x, int y)
+{
+        if (!valid_edge(*bit, x, y)) {
+                return;
+        }
+        Stack_T Primary = Stack_new();
+        struct index *coord = make_coord(x, y);
+        if (Primary == NULL || coord == NULL) {
+                Bit2_free(bit);
+                RAISE(Malloc_Fail);
+        }
+        Stack_push(Primary, coord);
+        while (!Stack_empty(Primary)) {
+                struct index *new_ind = Stack_pop(Primary);
+                if (!clear_full_block(new_ind, &Primary, *bit)) {
+                        Bit2_put(*bit, new_ind->x, new_ind->y, 0);
+                        visit_neighbor(new_ind, &Primary, *bit);
+                }
+                free(new_ind);
+        }
+        Stack_free(&Primary);
+}
+
+/*
+Description: If the pixel at ind lies in a full block of the pyramid
+        (trying the largest blocks first), clears that block and pushes
+        the black pixels bordering it onto the stack
+Input: pointer to index struct, pointer to the Stack_T of pixels to be
+        changed to white, and a Bit2_T map with a built pyramid
+Output: true if a block was cleared, false otherwise
+*/
+bool clear_full_block(struct index *ind, Stack_T *Primary, Bit2_T bit)
+{
+        for (int level = BIT2_LEVELS - 1; level >= 0; level--) {
+                int size = Bit2_block_size(level);
+                if (!Bit2_block_all(bit, level, ind->x / size,
+                                    ind->y / size)) {
+                        continue;
+                }
+                int left = ind->x / size * size;
+                int top = ind->y / size * size;
+                int w = Bit2_width(bit) - left < size ?
+                        Bit2_width(bit) - left : size;
+                int h = Bit2_height(bit) - top < size ?
+                        Bit2_height(bit) - top : size;
+                Bit2_clear_rect(bit, left, top, w, h);
+
+                for (int i = 0; i < w; i++) {
+                        if (valid_edge(bit, left + i, top - 1)) {
+                                Stack_push(*Primary,
+                                           make_coord(left + i, top - 1));
+                        }
+                        if (valid_edge(bit, left + i, top + h)) {
+                                Stack_push(*Primary,
+                                           make_coord(left + i, top + h));
+                        }
+                }
+                for (int j = 0; j < h; j++) {
+                        if (valid_edge(bit, left - 1, top + j)) {
+                                Stack_push(*Primary,
+                                           make_coord(left - 1, top + j));
+                        }
+                        if (valid_edge(bit, left + w, top + j)) {
+                                Stack_push(*Primary,
+                                           make_coord(left + w, top + j));
+                        }
+                }
+                return true;
+        }
+        return false;
+}
+
+/*
+Description: writes the image to the file, cropped to the box around
+        its black pixels (plus padding) when --crop was given. The crop
+        is a Bit2 view, so no pixels are copied. A blank image is
+        written as a single white pixel when cropped. With --native the
+        image is written as an indexed Bit2 native file, not as PBM.
+Input: a pointer to a file, a Bit2_T array, the command line options
+Output: nothing
+*/
+void write_image(FILE *outputfp, Bit2_T bitarr, struct options *opts)
+{
+        if (opts->crop < 0) {
+                if (opts->native) {
+                        Bit2_save(bitarr, outputfp, 1);
+                } else {
+                        pbmwrite(outputfp, bitarr);
+                }
+                return;
+        }
+        int x = 0;
+        int y = 0;
+        int width = 1;
+        int height = 1;
+        if (Bit2_bbox(bitarr, &x, &y, &width, &height)) {
+                int right = x + width + opts->crop;
+                int bottom = y + height + opts->crop;
+                x = x - opts->crop < 0 ? 0 : x - opts->crop;
+                y = y - opts->crop < 0 ? 0 : y - opts->crop;
+                width = (right > Bit2_width(bitarr) ?
+                         Bit2_width(bitarr) : right) - x;
+                height = (bottom > Bit2_height(bitarr) ?
+                          Bit2_height(bitarr) : bottom) - y;
+        }
+        Bit2_T cropped = Bit2_view(bitarr, x, y, width, height);
+        if (opts->native) {
+                Bit2_save(cropped, outputfp, 1);
+        } else {
+                pbmwrite(outputfp, cropped);
+        }
+        Bit2_free(&cropped);
+}
+
 /*
 Description: writes pixels of the Bit2_T map pointed
-        to by bitarr to the file pointed to by outputfp
+        to by bitarr to the file pointed to by outputfp. Each row is
+        formatted into a line first, and a row sharing its storage with
+        the row before it (Bit2_same_row) writes that line again.
 Input: a pointer to a file, a pointer to a
         Bit2_T array
 Output: nothing
@@ -184,21 +1030,45 @@ void pbmwrite(FILE *outputfp, Bit2_T bitarr)
                 Bit2_free(&bitarr);
                 RAISE(Bad_Pointer);
         }
+        int width = Bit2_width(bitarr);
+        char *line = malloc(2 * (size_t)width + 2);
+        if (line == NULL) {
+                Bit2_free(&bitarr);
+                RAISE(Malloc_Fail);
+        }
         fprintf(outputfp, "P1\n");
         fprintf(outputfp, "# Have Mercy\n");
-        fprintf(outputfp, "%d %d\n", Bit2_width(bitarr), Bit2_height(bitarr));
+        fprintf(outputfp, "%d %d\n", width, Bit2_height(bitarr));
         for (int y = 0; y < Bit2_height(bitarr); y++) {
-          for (int x = 0; x < Bit2_width(bitarr); x++) {
+          if (y > 0 && Bit2_same_row(bitarr, y, y - 1)) {
+                  fputs(line, outputfp);
+                  continue;
+          }
+          char *next = line;
+          for (int x = 0; x < width; x++) {
+                  /* Blocks the pyramid knows are blank are written whole,
+                  as long as they do not hold the last pixel of the row */
+                  if (x % BIT2_BLOCK0 == 0 &&
+                      x + BIT2_BLOCK0 < width &&
+                      !Bit2_block_any(bitarr, 0, x / BIT2_BLOCK0,
+                                      y / BIT2_BLOCK0)) {
+                          memcpy(next, "0 0 0 0 0 0 0 0 ", 2 * BIT2_BLOCK0);
+                          next += 2 * BIT2_BLOCK0;
+                          x += BIT2_BLOCK0 - 1;
+                          continue;
+                  }
+                  *next++ = '0' + Bit2_get(bitarr, x, y);
                   /* Prevents space from being printed after the last
                   character in the row */
-                  if (x == (Bit2_width(bitarr) - 1)) {
-                          fprintf(outputfp, "%d", Bit2_get(bitarr, x, y));
-                  } else {
-                          fprintf(outputfp, "%d ", Bit2_get(bitarr, x, y));
+                  if (x != width - 1) {
+                          *next++ = ' ';
                   }
           }
-        fprintf(outputfp, "\n");
+          *next++ = '\n';
+          *next = '\0';
+          fputs(line, outputfp);
         }
+        free(line);
 }
 
 /*